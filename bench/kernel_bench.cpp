@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../include/algorithms/hypercube_search.h"
+#include "../include/algorithms/ivfpq_search.h"
+#include "../include/algorithms/lsh_search.h"
+#include "../include/common/dataset.h"
+#include "../include/common/metrics.h"
+#include "../include/utils/args_parser.h"
+
+/*
+    Kernel microbenchmarks
+
+    Times the hot kernels of the search pipeline in isolation on synthetic
+    data (integer values in [0, 255], so byte and float kernels see the same
+    rows), for dimensions 3 (toy), 128 (SIFT) and 784 (MNIST):
+        - metrics::distance / comparison_distance, per SIMD level
+        - LSHSearch::hash_points + key_of / bucket_of (all L tables)
+        - HypercubeSearch::hash_vector
+        - IVFPQSearch: nearest_centroid, encode_point, LUT construction
+        - select_top_n over a candidate list
+    Each case runs `warmup` untimed passes, then `reps` timed passes; the
+    minimum and median pass times are reported, plus ns per item at the
+    minimum.
+
+    Usage: bench [-reps 9] [-warmup 2] [-n 10000] [-filter substring]
+*/
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    int reps = 9;
+    int warmup = 2;
+    std::size_t n = 10000; // rows indexed / scanned per case
+    std::string filter;
+};
+
+Options opts;
+
+volatile double sink; // keeps results of timed loops alive
+
+// Runs fn (one pass over `items` items) and prints one table row
+template <typename Fn>
+void measure(const std::string& kernel, std::size_t dim, std::size_t items, Fn&& fn) {
+    if (!opts.filter.empty() && kernel.find(opts.filter) == std::string::npos) return;
+    for (int i = 0; i < opts.warmup; ++i) fn();
+    std::vector<double> us(static_cast<std::size_t>(std::max(1, opts.reps)));
+    for (double& t : us) {
+        auto t0 = Clock::now();
+        fn();
+        t = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+    }
+    std::sort(us.begin(), us.end());
+    const double min_us = us.front(), median_us = us[us.size() / 2];
+    std::cout << std::left << std::setw(36) << kernel << std::right << std::setw(5) << dim
+              << std::setw(9) << items << std::fixed << std::setprecision(1)
+              << std::setw(12) << min_us << std::setw(12) << median_us
+              << std::setprecision(2) << std::setw(12) << 1000.0 * min_us / static_cast<double>(items) << "\n";
+}
+
+// Swallows std::cout while indexes log their build steps
+struct QuietCout {
+    std::ostringstream null;
+    std::streambuf* saved = std::cout.rdbuf(null.rdbuf());
+    ~QuietCout() { std::cout.rdbuf(saved); }
+};
+
+FloatMatrix random_rows(std::size_t rows, std::size_t dim, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> value(0, 255);
+    FloatMatrix m(rows, dim);
+    for (std::size_t i = 0; i < rows; ++i)
+        for (std::size_t j = 0; j < dim; ++j) m[i][j] = static_cast<float>(value(rng));
+    return m;
+}
+
+Args bench_args() {
+    Args args;
+    args.threads = 1;
+    args.N = 10;
+    args.R = 0.0;
+    args.algo = "bench";
+    return args;
+}
+
+} // namespace
+
+// Friend of the index classes: reaches the private kernels
+struct KernelBench {
+    static void distances(const Dataset& data, const FloatMatrix& queries) {
+        const std::size_t dim = data.dim(), n = data.rows();
+        ByteMatrix bytes(n, dim);
+        for (std::size_t i = 0; i < n; ++i)
+            for (std::size_t j = 0; j < dim; ++j) bytes[i][j] = static_cast<std::uint8_t>(data.row(i)[j]);
+        std::vector<std::uint8_t> qb(queries[0], queries[0] + dim);
+        const float* q = queries[0];
+
+        const metrics::SimdLevel top = metrics::detect_simd_level();
+        for (int l = 0; l <= static_cast<int>(top); ++l) {
+            const auto level = static_cast<metrics::SimdLevel>(l);
+            metrics::set_simd_level(level);
+            const std::string isa = std::string("/") + metrics::simd_level_name(level);
+            for (auto type : {metrics::MetricType::L2, metrics::MetricType::L1}) {
+                metrics::MetricConfig cfg;
+                cfg.type = type;
+                const std::string m = type == metrics::MetricType::L2 ? "l2" : "l1";
+                measure("distance " + m + " f32" + isa, dim, n, [&] {
+                    double acc = 0.0;
+                    for (std::size_t i = 0; i < n; ++i) acc += metrics::distance(q, data.row(i), dim, cfg);
+                    sink = acc;
+                });
+                measure("comparison_distance " + m + " u8" + isa, dim, n, [&] {
+                    double acc = 0.0;
+                    for (std::size_t i = 0; i < n; ++i) acc += metrics::comparison_distance(qb.data(), bytes[i], dim, cfg);
+                    sink = acc;
+                });
+            }
+        }
+        metrics::set_simd_level(top);
+    }
+
+    static void lsh(const Dataset& data, const FloatMatrix& queries) {
+        Args args = bench_args();
+        args.k = 4;
+        args.L = 5;
+        args.w = 4.0;
+        LSHSearch index;
+        {
+            QuietCout quiet;
+            index.configure(args);
+            index.build_index(data);
+        }
+        const std::size_t nq = queries.rows();
+        measure("LSH hash_points + keys (L=5, k=4)", data.dim(), nq, [&] {
+            long acc = 0;
+            std::vector<int> h(index.n_hashes());
+            for (std::size_t i = 0; i < nq; ++i) {
+                index.hash_points(queries[i], queries.stride(), 1, h.data());
+                for (int t = 0; t < args.L; ++t) acc += index.bucket_of(index.key_of(t, h.data()));
+            }
+            sink = static_cast<double>(acc);
+        });
+    }
+
+    static void hypercube(const Dataset& data, const FloatMatrix& queries) {
+        Args args = bench_args();
+        args.kproj = 14;
+        args.w = 4.0;
+        HypercubeSearch index;
+        {
+            QuietCout quiet;
+            index.configure(args);
+            index.build_index(data);
+        }
+        const std::size_t nq = queries.rows();
+        measure("Hypercube hash_vector (kproj=14)", data.dim(), nq, [&] {
+            std::uint64_t acc = 0;
+            for (std::size_t i = 0; i < nq; ++i) acc += index.hash_vector(queries[i]);
+            sink = static_cast<double>(acc);
+        });
+    }
+
+    static void ivfpq(const Dataset& data, const FloatMatrix& queries) {
+        const std::size_t dim = data.dim();
+        Args args = bench_args();
+        args.kclusters = 64;
+        args.nprobe = 8;
+        args.pq_M = dim % 16 == 0 ? 16 : 1; // 784 = 16 x 49
+        args.pq_nbits = 8;
+        IVFPQSearch index;
+        {
+            QuietCout quiet;
+            index.configure(args);
+            index.build_index(data);
+        }
+        if (!index.index_built) {
+            std::cerr << "[Bench] IVFPQ index not built for dim " << dim << ", skipped\n";
+            return;
+        }
+
+        const std::size_t nq = queries.rows();
+        std::vector<Vector> qv(nq);
+        for (std::size_t i = 0; i < nq; ++i) row_to_vector(queries[i], dim, qv[i]);
+        measure("IVFPQ nearest_centroid (k=64)", dim, nq, [&] {
+            long acc = 0;
+            for (const Vector& v : qv) acc += index.nearest_centroid(v);
+            sink = static_cast<double>(acc);
+        });
+        measure("IVFPQ encode_point (M=" + std::to_string(args.pq_M) + ")", dim, nq, [&] {
+            long acc = 0;
+            for (std::size_t i = 0; i < nq; ++i) acc += index.encode_point(queries[i], static_cast<int>(i % 64))[0];
+            sink = static_cast<double>(acc);
+        });
+        std::vector<std::vector<double>> lut(static_cast<std::size_t>(index.p.M),
+                                             std::vector<double>(static_cast<std::size_t>(index.codebook_size_)));
+        measure("IVFPQ compute_lut (256 codewords)", dim, nq, [&] {
+            double acc = 0.0;
+            for (std::size_t i = 0; i < nq; ++i) {
+                index.compute_lut(qv[i], static_cast<int>(i % 64), lut);
+                acc += lut[0][0];
+            }
+            sink = acc;
+        });
+    }
+
+    static void top_n() {
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<double> dist(0.0, 1e6);
+        for (std::size_t count : {std::size_t(1000), opts.n}) {
+            std::vector<std::pair<int, double>> source(count), cands;
+            for (std::size_t i = 0; i < count; ++i) source[i] = {static_cast<int>(i), dist(rng)};
+            for (int N : {1, 10, 100}) {
+                measure("select_top_n N=" + std::to_string(N) + " (incl. copy)", 0, count, [&] {
+                    cands = source;
+                    sink = static_cast<double>(select_top_n(cands, N));
+                });
+            }
+        }
+    }
+};
+
+int main(int argc, char** argv) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string flag = argv[i], value = argv[i + 1];
+        if (flag == "-reps") opts.reps = std::atoi(value.c_str());
+        else if (flag == "-warmup") opts.warmup = std::atoi(value.c_str());
+        else if (flag == "-n") opts.n = static_cast<std::size_t>(std::max(1, std::atoi(value.c_str())));
+        else if (flag == "-filter") opts.filter = value;
+        else {
+            std::cerr << "Unknown option " << flag << "\n";
+            return 1;
+        }
+    }
+
+    std::cout << "=== Kernel Bench === SIMD " << metrics::simd_level_name(metrics::detect_simd_level())
+              << ", reps=" << opts.reps << ", warmup=" << opts.warmup << ", n=" << opts.n << "\n"
+              << std::left << std::setw(36) << "kernel" << std::right << std::setw(5) << "dim" << std::setw(9)
+              << "items" << std::setw(12) << "min(us)" << std::setw(12) << "median(us)" << std::setw(12)
+              << "ns/item" << "\n";
+
+    for (std::size_t dim : {std::size_t(3), std::size_t(128), std::size_t(784)}) {
+        const Dataset data(random_rows(opts.n, dim, 1));
+        const FloatMatrix queries = random_rows(1000, dim, 2);
+        KernelBench::distances(data, queries);
+        KernelBench::lsh(data, queries);
+        KernelBench::hypercube(data, queries);
+        KernelBench::ivfpq(data, queries);
+    }
+    KernelBench::top_n();
+    return 0;
+}
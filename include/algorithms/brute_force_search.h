@@ -14,14 +14,34 @@
 
 class BruteForceSearch : public SearchAlgorithm {
 private:
-    std::vector<Vector> feature_vectors;
+    Dataset feature_vectors;
     int n_points = 0;
     int space_dim = 0;
+    // ||x||^2 of every row and their maximum (float datasets), for search_batch
+    std::vector<float> norms_;
+    float max_norm_ = 0.0f;
+    // per-NUMA-node copies of the rows (-numa_replicate), see numa::local
+    std::vector<Dataset> replicas_;
+    bool numa_replicate_ = false;
+    int threads_ = 1;
+
+    // scan loop specialised per metric (see metrics::Metric)
+    template <typename Metric>
+    SearchResult search_impl(const Metric& metric, const Vector& query, const Params& params, int query_id) const;
 public:
     BruteForceSearch() = default;
-    void build_index(const std::vector<Vector>& dataset) override;
+    void build_index(const Dataset& dataset) override;
     SearchResult search(const Vector& query, const Params& params, int query_id) const override;
-    void configure(const Args& args) override { (void)args; } // brute uses global defaults
+    // Exact search for a whole query set on num_threads threads. L2 over float
+    // rows is computed tile by tile as ||q||^2 + ||x||^2 - 2 q.x; every other
+    // case runs search() per query. Results equal those of search().
+    std::vector<SearchResult> search_batch(const Vector* queries, std::size_t nq, const Params& params,
+                                           int num_threads) const;
+    // one runner batch on the calling thread, tiled as above
+    std::vector<SearchResult> search_batch(const Vector* queries, std::size_t nq, const Params& params) const override {
+        return search_batch(queries, nq, params, 1);
+    }
+    void configure(const Args& args) override; // only placement options; search uses global defaults
     std::string name() const override { return "BruteForce"; }
 };
 
@@ -13,9 +13,9 @@ and the overall structure is working fine (builds and runs successfully).
 
 class DummySearch : public SearchAlgorithm {
 private:
-    std::vector<Vector> data;
+    Dataset data;
 public:
-    void build_index(const std::vector<Vector>& dataset) override;
+    void build_index(const Dataset& dataset) override;
     SearchResult search(const Vector& query, const Params& params, int query_id) const override;
     void configure(const Args& a) override { (void)a; }
     std::string name() const override { return "Dummy"; }
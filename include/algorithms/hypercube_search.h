@@ -11,7 +11,10 @@
 class HypercubeSearch : public SearchAlgorithm {
 public:
     void configure(const Args& args) override;
-    void build_index(const std::vector<Vector>& dataset) override;
+    void set_search_params(const Args& args) override;
+    void build_index(const Dataset& dataset) override;
+    bool save_index(const std::string& path) const override;
+    bool load_index(const std::string& path, const Dataset& dataset) override;
     SearchResult search(const Vector& query, const Params& params, int query_id) const override;
     std::string name() const override { return "Hypercube"; }
 
@@ -22,16 +25,21 @@ private:
     int kproj_ = 14;
     int max_candidates_ = 10;
     int max_probes_ = 2;
-    double w_ = 4.0;
+    double w_ = 600.0;
 
     uint32_t space_dim_ = 0;
-    std::vector<Vector> dataset_;
+    Dataset dataset_;
     std::unordered_map<uint32_t, Bucket> cube_;
     std::vector<std::vector<double>> projections_;
     std::vector<double> offsets_;
 
-    uint32_t hash_vector(const std::vector<double>& vec) const;
+    uint32_t hash_vector(const float* vec) const;
+    // probing / verification loop specialised per metric (see metrics::Metric)
+    template <typename Metric>
+    SearchResult search_impl(const Metric& metric, const Vector& query, const Params& params, int query_id) const;
     bool coin_flip(int function_index, int cell) const;
     static uint64_t splitmix64(uint64_t x);
+
+    friend struct KernelBench; // bench/kernel_bench.cpp times the private kernels
 };
 #endif // HYPERCUBE_SEARCH_H
\ No newline at end of file
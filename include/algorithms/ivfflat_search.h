@@ -7,13 +7,22 @@
 #include <random>
 #include <cstdint>
 
+// One inverted list: ids plus a copy of their vectors packed row by row,
+// so probing a list is a single linear scan over aligned memory. Lists
+// keep the dataset's element type: exactly one of the matrices is filled.
+struct InvertedList {
+    std::vector<int> ids;
+    FloatMatrix vectors;     // vectors.row(r) == dataset row ids[r]
+    ByteMatrix byte_vectors; // same, for uint8 datasets
+};
+
 struct IVFFlatParams {
     int seed = 1;
     int kclusters = 50;
     int nprobe = 5;
     int N = 1;
     double R = 2000.0;
-    
+    int threads = 1; // index construction
 };
 
 class IVFFlatSearch : public SearchAlgorithm {
@@ -22,19 +31,22 @@ private:
     IVFFlatParams p;
     std::mt19937 rng;
     
-    std::vector<Vector> data;
+    Dataset data;
     std::vector<Vector> subset_data;
     
     std::vector<Vector> centroids; 
     std::vector<int> assigned_centroid;
     
-    std::vector<std::vector<std::pair<int, Vector>>> IL;
+    // inverted lists, one per centroid
+    std::vector<InvertedList> IL;
 
     int space_dim = 0;
     int n_points = 0;
     bool index_built = false;
 
     // Helper Functions
+    void load_row(int i, Vector& out) const;
+    double point_distance(int a, int b) const;
     int nearest_centroid(const Vector& vec);
     int second_nearest_centroid(const Vector& vec);
 
@@ -43,16 +55,46 @@ private:
     void initialization(); // K-Means++ initialization
     void update();         // Centroid update (K-Medians)
     int assignment_lloyds(); // Assigns subset vectors to nearest cluster
+    // inverted lists from assigned_centroid, ids in order, vectors packed
+    void fill_lists();
+
+    // a query in the forms the list kernels take
+    struct QueryRows {
+        std::vector<float> q;
+        std::vector<uint8_t> qb;
+        bool byte_query = false; // byte dataset and byte-valued query: integer kernels
+    };
+    QueryRows prepare_query(const Vector& query) const;
+
+    // probe + list scan specialised per metric (see metrics::Metric)
+    template <typename Metric>
+    std::vector<std::pair<int, double>> probe_lists(const Metric& metric, const Vector& query, SearchStats& stats) const;
+    template <typename Metric>
+    void scan_rows(const Metric& metric, const QueryRows& qr, const InvertedList& list,
+                   size_t r0, size_t count, double* out) const;
+    template <typename Metric>
+    void finish(std::vector<std::pair<int, double>>& b, const Params& params, SearchResult& res) const;
+    template <typename Metric>
+    SearchResult search_impl(const Metric& metric, const Vector& query, const Params& params, int query_id) const;
+    template <typename Metric>
+    std::vector<SearchResult> search_batch_impl(const Metric& metric, const Vector* queries, size_t nq,
+                                                const Params& params) const;
 
 
 public:
     IVFFlatSearch() : rng(p.seed) {} 
 
-    void build_index(const std::vector<Vector>& dataset) override;
+    void build_index(const Dataset& dataset) override;
+    // centroids and assignments; list vectors are re-packed from the dataset
+    bool save_index(const std::string& path) const override;
+    bool load_index(const std::string& path, const Dataset& dataset) override;
     void configure(const Args& args) override;
+    void set_search_params(const Args& args) override;
 
     // Search
     SearchResult search(const Vector& query, const Params& params, int query_id) const;
+    // probed lists are streamed once per batch for all queries probing them
+    std::vector<SearchResult> search_batch(const Vector* queries, size_t nq, const Params& params) const override;
 
     // Utility/Getter methods
     std::vector<Vector> get_centroids();
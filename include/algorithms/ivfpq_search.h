@@ -3,6 +3,7 @@
 
 #include "search_algorithm.h"
 #include <cstdint>
+#include <memory>
 #include <random>
 #include <vector>
 
@@ -14,6 +15,7 @@ struct IVFPQParams {
     int nbits = 8;
     int N = 1;
     double R = 2000.0;
+    int threads = 1; // index construction
 };
 
 class IVFPQSearch : public SearchAlgorithm {
@@ -21,14 +23,30 @@ private:
     IVFPQParams p;
     std::mt19937 rng;
 
-    std::vector<Vector> data;
+    Dataset data;
     std::vector<Vector> subset_data;
     std::vector<Vector> centroids;
     std::vector<int> subset_assignments_;
     std::vector<int> data_assignments_;
 
-    std::vector<std::vector<int>> inverted_lists_;
-    std::vector<std::vector<std::uint8_t>> point_codes_;
+    // Inverted lists in compressed-sparse-row form (as LSHTable): list c holds
+    // entries [list_offsets_[c], list_offsets_[c + 1]) in id order; entry e is
+    // point list_ids_[e] with PQ code list_codes_[e * M, (e + 1) * M), so a
+    // list's codes are one contiguous run. The arrays are kept alive by
+    // lists_owner_: a ListArrays filled by build_index, or the mapping of the
+    // index file, which load_index reads them from in place. ids and codes
+    // are written list by list on the pool threads (first-touch, see
+    // utils/numa.h); a mapped file stays wherever the page cache put it.
+    struct ListArrays {
+        std::vector<std::uint32_t> offsets;
+        Matrix<int> ids;             // one row of n_entries
+        Matrix<std::uint8_t> codes;  // n_entries rows of M
+    };
+    std::shared_ptr<const void> lists_owner_;
+    const std::uint32_t* list_offsets_ = nullptr; // n_lists_ + 1 entries
+    const int* list_ids_ = nullptr;
+    const std::uint8_t* list_codes_ = nullptr;
+    size_t n_lists_ = 0;
     std::vector<std::vector<Vector>> pq_codebooks_;
 
     int space_dim_ = 0;
@@ -47,16 +65,43 @@ private:
 
     // Product Quantization helpers
     void build_pq_codebooks();
-    std::vector<double> compute_residual(const Vector& vec, int centroid_idx) const;
-    std::vector<std::uint8_t> encode_point(const Vector& vec, int centroid_idx) const;
+    std::vector<double> compute_residual(const float* vec, int centroid_idx) const;
+    std::vector<std::uint8_t> encode_point(const float* vec, int centroid_idx) const;
+    // list arrays from data_assignments_ and the per-point codes [n][M]
+    void fill_lists(const std::vector<std::uint8_t>& codes);
+    size_t list_size(size_t cid) const { return list_offsets_[cid + 1] - list_offsets_[cid]; }
+    // lut[m][h] = squared distance between sub-vector m of (query - centroid) and codeword h
+    void compute_lut(const Vector& query, int centroid_idx, std::vector<std::vector<double>>& lut) const;
+
+    struct Candidate { int idx; double dist; };
+
+    bool searchable(const Vector& query) const;
+    void scan_list(int cid, const std::vector<std::vector<double>>& lut, Candidate* out) const;
+
+    // coarse probe + exact fallback specialised per metric (see metrics::Metric)
+    template <typename Metric>
+    std::vector<std::pair<int, double>> probe_lists(const Metric& metric, const Vector& query, SearchStats& stats) const;
+    template <typename Metric>
+    void finish(const Metric& metric, const Vector& query, std::vector<Candidate>& candidates,
+                const Params& params, SearchResult& res) const;
+    template <typename Metric>
+    SearchResult search_impl(const Metric& metric, const Vector& query, const Params& params, int query_id) const;
+    template <typename Metric>
+    std::vector<SearchResult> search_batch_impl(const Metric& metric, const Vector* queries, size_t nq,
+                                                const Params& params) const;
 
 public:
     IVFPQSearch() : rng(p.seed) {}
 
     void configure(const Args& args) override;
-    void build_index(const std::vector<Vector>& dataset) override;
+    void set_search_params(const Args& args) override;
+    void build_index(const Dataset& dataset) override;
+    bool save_index(const std::string& path) const override;
+    bool load_index(const std::string& path, const Dataset& dataset) override;
 
     SearchResult search(const Vector& query, const Params& params, int query_id) const override;
+    // probed lists are scanned once per batch for all queries probing them
+    std::vector<SearchResult> search_batch(const Vector* queries, size_t nq, const Params& params) const override;
 
     std::vector<Vector> get_centroids() const { return centroids; }
     std::vector<std::vector<int>> get_centroids_map() const;
@@ -65,6 +110,8 @@ public:
     std::pair<std::vector<double>, double> compute_silhouette() const;
 
     std::string name() const override { return "IVFPQ"; }
+
+    friend struct KernelBench; // bench/kernel_bench.cpp times the private kernels
 };
 
 #endif // IVFPQ_SEARCH_H
\ No newline at end of file
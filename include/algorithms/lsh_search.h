@@ -7,20 +7,31 @@
 #include <unordered_map>
 #include <vector>
 #include <cstdint>
-#include <list>
 
 // LSH parameters
 struct LSHParams {
     int seed = 1;
     int k = 4;         // number of hi per g (hash functions per table)
     int L = 5;         // number of tables
-    double w = 123456;    // window length
+    double w = 600.0;  // bucket width of h_j (configure sets Args::w)
     int N = 1;
     double R = 2000.0; // default for MNIST; override to 2 for SIFT
 
 	uint32_t c = 1; 
-	uint32_t M = 256;
-	uint64_t m = pow(2,32) - 5;
+	int table_size = 0; // requested buckets per table, 0 = n / 8
+	uint32_t M = 256;   // buckets in use: table_size rounded up to a power of two
+	int threads = 1; // index construction
+	int T = 0;       // multi-probe: extra buckets visited per table
+};
+
+// One hash table in compressed-sparse-row form: bucket b holds entries
+// [offsets[b], offsets[b + 1]), in point order. Each entry keeps the full
+// 64-bit key of g(x), so points that only share the bucket are skipped
+// without computing their distance.
+struct LSHTable {
+    std::vector<uint32_t> offsets; // M + 1 entries
+    std::vector<int> ids;          // every point exactly once
+    std::vector<uint64_t> keys;    // keys[e] = g key of ids[e]
 };
 
 class LSHSearch : public SearchAlgorithm {
@@ -28,28 +39,72 @@ private:
     LSHParams p;
     std::mt19937 rng;
 
-    std::vector<Vector> data;
+    Dataset data;
 
-    std::vector<std::vector<std::vector<std::pair<int, double>>>> amplified_hash_fns;
-    std::vector<std::vector<std::list<int>>> lsh_tables;
+    // E2LSH functions h_j(x) = floor((a_j . x + b_j) / w), j < L * k, table
+    // t using j in [t * k, (t + 1) * k). The Gaussian a_j are packed
+    // metrics::kDotPanel functions per row (see pack_dot_panel), so hashing
+    // a point is one panel-kernel pass per 16 functions.
+    FloatMatrix proj_panels;
+    std::vector<float> shifts;       // b_j, uniform in [0, w)
+    std::vector<uint64_t> key_mult;  // r_j, random odd: key of g = sum(r_j * h_j) mod 2^64
+    int table_bits = 8;              // M = 2^table_bits
+    std::vector<LSHTable> lsh_tables;
 
     int space_dim = 0;
     int n_points = 0;
     bool index_built = false;
 
     // Hastables
+    void set_table_size();
     void build_hashes();
-    void initialize();
     void build_tables();
-    int modulo(int a, int b) const;
-    int modular_power(int x, int y, int p);
-    int assign_to_bucket(const std::vector<std::vector<std::pair<int, double>>>& amplified_fn, const Vector& x) const;
+    int n_hashes() const { return p.L * p.k; }
+    // h[i * n_hashes() + j] = h_j(row i) for nx rows; nx = 1 (a query) goes
+    // through the matrix-vector kernel instead of the multi-row panel one
+    // (frac, if given: position of each projection within its slot, in [0, 1))
+    void hash_points(const float* xs, size_t stride, size_t nx, int* h, double* frac = nullptr) const;
+    // key of g for table t from a point's hash values h (all n_hashes() of them)
+    uint64_t key_of(int t, const int* h) const;
+    // top table_bits bits of the key, mixed (multiplicative hashing)
+    uint32_t bucket_of(uint64_t key) const;
+    // Buffers of probe_sequence, one instance per thread (for_thread), so
+    // probing allocates nothing once they have grown. A perturbation is a
+    // set of single moves, stored as a bitmask over `moves`.
+    struct ProbeSets {
+        struct Move {
+            double cost;
+            int coord, delta; // h_coord += delta
+        };
+        struct Set {
+            double score;
+            uint64_t moves;
+        };
+        std::vector<Move> moves; // sorted by cost, at most 64
+        std::vector<Set> heap;
+        std::vector<uint64_t> sets; // result: most likely first
+
+        static ProbeSets& for_thread() {
+            thread_local ProbeSets scratch;
+            return scratch;
+        }
+    };
+    // up to T perturbations of one table's k hash values into out.sets, most
+    // likely first, from the query's slot positions frac[0 .. k)
+    void probe_sequence(const double* frac, int T, ProbeSets& out) const;
+
+    // candidate verification specialised per metric (see metrics::Metric)
+    template <typename Metric>
+    SearchResult search_impl(const Metric& metric, const Vector& query, const Params& params, int query_id) const;
 
 public:
     LSHSearch() : rng(p.seed) {} 
 
-    void build_index(const std::vector<Vector>& dataset) override;
+    void build_index(const Dataset& dataset) override;
+    bool save_index(const std::string& path) const override;
+    bool load_index(const std::string& path, const Dataset& dataset) override;
     void configure(const Args& args) override;
+    void set_search_params(const Args& args) override;
 
     // Search
     SearchResult search(const Vector& query, const Params& params, int query_id) const;
@@ -57,6 +112,7 @@ public:
 
     std::string name() const override { return "LSH"; }
 
+    friend struct KernelBench; // bench/kernel_bench.cpp times the private kernels
 
 };
 
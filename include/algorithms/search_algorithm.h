@@ -7,14 +7,79 @@ All search algorithms should inherit from this class and implement
 the build_index and search methods.
 */
 
+#include <algorithm>
 #include <vector>
 #include <string>
+#include <cstdint>
+#include <utility>
+
+#include "../common/dataset.h"
 
 // Basic vector & results
 struct Vector {
     std::vector<double> values;
 };
 
+// Copy a float row into a (reusable) double Vector
+inline void row_to_vector(const float* row, std::size_t dim, Vector& out) {
+    out.values.assign(row, row + dim);
+}
+
+inline void row_to_vector(const std::uint8_t* row, std::size_t dim, Vector& out) {
+    out.values.assign(row, row + dim);
+}
+
+// Narrow a query to float so it can be compared against dataset rows
+inline std::vector<float> to_float(const Vector& v) {
+    return std::vector<float>(v.values.begin(), v.values.end());
+}
+
+// Narrow a query to bytes for the integer kernels; false (out unspecified)
+// if any component is not an integer in [0, 255]
+inline bool to_bytes(const Vector& v, std::vector<std::uint8_t>& out) {
+    out.resize(v.values.size());
+    for (std::size_t i = 0; i < v.values.size(); ++i) {
+        const double x = v.values[i];
+        if (!(x >= 0.0 && x <= 255.0) || x != static_cast<double>(static_cast<int>(x))) return false;
+        out[i] = static_cast<std::uint8_t>(x);
+    }
+    return true;
+}
+
+// Move the n closest (id, distance) candidates to the front, sorted; returns
+// how many there are (min(n, size))
+inline int select_top_n(std::vector<std::pair<int, double>>& cands, int n) {
+    const int top = std::min(n, static_cast<int>(cands.size()));
+    std::partial_sort(cands.begin(), cands.begin() + top, cands.end(),
+                      [](const auto& a, const auto& b) { return a.second < b.second; });
+    return top;
+}
+
+// Work done by one query, filled by each algorithm's search. Counters an
+// algorithm has no notion of stay 0.
+struct SearchStats {
+    std::uint64_t distance_computations = 0; // exact distances (dataset rows, centroids) and dot products
+    std::uint64_t candidates = 0;            // candidate ids gathered from buckets / lists, duplicates included
+    std::uint64_t unique_candidates = 0;     // left after deduplication (= candidates if none is done)
+    std::uint64_t buckets_probed = 0;        // LSH buckets, hypercube vertices, inverted lists
+    std::uint64_t lut_builds = 0;            // IVFPQ distance tables
+    std::uint64_t adc_evaluations = 0;       // IVFPQ table-lookup distances
+    std::uint64_t bytes_scanned = 0;         // vector and code bytes read to compute distances
+    std::uint64_t heap_operations = 0;       // top-N heap pushes/pops (partial sorts: one per input)
+
+    SearchStats& operator+=(const SearchStats& o) {
+        distance_computations += o.distance_computations;
+        candidates += o.candidates;
+        unique_candidates += o.unique_candidates;
+        buckets_probed += o.buckets_probed;
+        lut_builds += o.lut_builds;
+        adc_evaluations += o.adc_evaluations;
+        bytes_scanned += o.bytes_scanned;
+        heap_operations += o.heap_operations;
+        return *this;
+    }
+};
+
 struct SearchResult {
     int query_id = -1;
     std::vector<int> neighbor_ids;
@@ -22,6 +87,9 @@ struct SearchResult {
     std::vector<int> range_neighbor_ids;
     std::vector<float> range_distances;
     double time_ms = 0.0;
+    bool shared_time = false; // time_ms is a share of a batch's time, not this query's own latency
+    int thread_id = -1; // worker of run_parallel_search that ran the query
+    SearchStats stats;
 };
 
 struct Params {
@@ -37,12 +105,38 @@ struct Args;
 class SearchAlgorithm {
 public:
     virtual ~SearchAlgorithm() = default;
-    // build index (from dataset)
-    virtual void build_index(const std::vector<Vector>& dataset) = 0;
+    // build index (from dataset, one vector per row); implementations keep
+    // a copy of the handle, which shares the rows instead of copying them
+    virtual void build_index(const Dataset& dataset) = 0;
     // run a single query
     virtual SearchResult search(const Vector& query, const Params& params, int query_id) const = 0;
+    // run the nq queries at `queries` as a batch (query_id = position in the
+    // batch); the default calls search() on each, overrides share work across
+    // the batch and must return the same neighbours. Overrides that cannot
+    // time queries one by one split the batch time and set shared_time.
+    virtual std::vector<SearchResult> search_batch(const Vector* queries, std::size_t nq, const Params& params) const {
+        std::vector<SearchResult> results;
+        results.reserve(nq);
+        for (std::size_t i = 0; i < nq; ++i)
+            results.push_back(search(queries[i], params, static_cast<int>(i)));
+        return results;
+    }
+    // write the built index to `path` (format in utils/index_io.h); false if
+    // this algorithm has nothing worth saving. Throws on I/O errors.
+    virtual bool save_index(const std::string& path) const { (void)path; return false; }
+    // replace build_index(dataset) by reading an index saved with the same
+    // dataset, metric and build parameters; false if this algorithm does not
+    // save indexes, std::runtime_error if the file does not match
+    virtual bool load_index(const std::string& path, const Dataset& dataset) {
+        (void)path;
+        (void)dataset;
+        return false;
+    }
     // configure algorithm with CLI args (defaults set by parse)
     virtual void configure(const Args& args) { (void)args; }
+    // re-read only the query-time parameters (nprobe, probes, ...) of a built
+    // index; must not change anything build_index depends on
+    virtual void set_search_params(const Args& args) { (void)args; }
     // name for output header
     virtual std::string name() const = 0;
 };
@@ -0,0 +1,116 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+/*
+Read-only, reference-counted handle to a loaded dataset.
+
+Copying a Dataset copies a pointer and bumps a reference count, never the
+vectors, so every index (the approximate one and the BruteForce truth)
+borrows the same rows. The storage is kept alive by `owner`, which is
+either a FloatMatrix handed over by the loader or any other buffer that
+outlives the rows (see the constructors taking an owner).
+
+Byte sources (MNIST pixels, .bvecs) keep their native uint8 elements, a
+quarter of the float32 footprint. Scans that have integer kernels
+(BruteForce, IVFFlat) read byte_row(); every other index asks for
+widened() once at build time and reads float rows as before.
+*/
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "matrix.h"
+
+using ByteMatrix = Matrix<std::uint8_t>;
+
+enum class ElemType { Float32, UInt8 };
+
+class Dataset {
+public:
+    Dataset() = default;
+
+    // take ownership of a loaded matrix (moved, not copied)
+    explicit Dataset(FloatMatrix matrix) {
+        auto owned = std::make_shared<const FloatMatrix>(std::move(matrix));
+        set(owned->data(), ElemType::Float32, owned->rows(), owned->dim(), owned->stride());
+        owner_ = std::move(owned);
+    }
+
+    explicit Dataset(ByteMatrix matrix) {
+        auto owned = std::make_shared<const ByteMatrix>(std::move(matrix));
+        set(owned->data(), ElemType::UInt8, owned->rows(), owned->dim(), owned->stride());
+        owner_ = std::move(owned);
+    }
+
+    // rows stored elsewhere, kept alive by owner; row i starts at base + i * stride
+    Dataset(std::shared_ptr<const void> owner, const float* base,
+            std::size_t rows, std::size_t dim, std::size_t stride)
+        : owner_(std::move(owner)) {
+        set(base, ElemType::Float32, rows, dim, stride);
+    }
+
+    Dataset(std::shared_ptr<const void> owner, const std::uint8_t* base,
+            std::size_t rows, std::size_t dim, std::size_t stride)
+        : owner_(std::move(owner)) {
+        set(base, ElemType::UInt8, rows, dim, stride);
+    }
+
+    std::size_t rows() const { return rows_; }
+    std::size_t dim() const { return dim_; }
+    // distance between consecutive rows, in elements
+    std::size_t stride() const { return stride_; }
+    std::size_t elem_size() const { return type_ == ElemType::UInt8 ? 1 : sizeof(float); }
+    std::size_t bytes() const { return rows_ * stride_ * elem_size(); }
+    bool empty() const { return rows_ == 0; }
+
+    ElemType elem_type() const { return type_; }
+    bool is_bytes() const { return type_ == ElemType::UInt8; }
+
+    const float* row(std::size_t i) const {
+        assert(type_ == ElemType::Float32);
+        return static_cast<const float*>(base_) + i * stride_;
+    }
+    const float* operator[](std::size_t i) const { return row(i); }
+
+    const std::uint8_t* byte_row(std::size_t i) const {
+        assert(type_ == ElemType::UInt8);
+        return static_cast<const std::uint8_t*>(base_) + i * stride_;
+    }
+
+    // float32 view for indexes without byte kernels: a byte dataset is
+    // widened into a new matrix, a float dataset is shared as is
+    Dataset widened() const {
+        if (type_ == ElemType::Float32) return *this;
+        FloatMatrix out(rows_, dim_);
+        for (std::size_t i = 0; i < rows_; ++i) {
+            const std::uint8_t* src = byte_row(i);
+            float* dst = out[i];
+            for (std::size_t j = 0; j < dim_; ++j) dst[j] = static_cast<float>(src[j]);
+        }
+        return Dataset(std::move(out));
+    }
+
+    // number of handles sharing the storage (diagnostics)
+    long use_count() const { return owner_.use_count(); }
+
+private:
+    std::shared_ptr<const void> owner_;
+    const void* base_ = nullptr;
+    ElemType type_ = ElemType::Float32;
+    std::size_t rows_ = 0;
+    std::size_t dim_ = 0;
+    std::size_t stride_ = 0;
+
+    void set(const void* base, ElemType type, std::size_t rows, std::size_t dim, std::size_t stride) {
+        base_ = base;
+        type_ = type;
+        rows_ = rows;
+        dim_ = dim;
+        stride_ = stride;
+    }
+};
+
+#endif // DATASET_H
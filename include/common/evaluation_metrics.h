@@ -2,16 +2,42 @@
 #define EVALUATION_METRICS_H
 
 #include "../algorithms/search_algorithm.h"
+#include <cstddef>
+#include <ostream>
 #include <vector>
 #include <string>
 #include <numeric>
 
+// Distribution of per-query latencies (SearchResult::time_ms), nearest-rank
+// percentiles over the queries timed on their own; count 0 when every time
+// was split from a batch (shared_time). Approx latencies are all or nothing;
+// truth ones may be the sample get_truth times one by one.
+struct LatencyStats {
+    std::size_t count = 0;
+    double mean = 0.0;
+    double p50 = 0.0, p90 = 0.0, p95 = 0.0, p99 = 0.0, p999 = 0.0, max = 0.0;
+};
+
+LatencyStats latency_stats(std::vector<double> times_ms);
+// "n=.. mean=.. p50=.. p90=.. p95=.. p99=.. p99.9=.. max=.." (ms), "n/a ..." if empty
+std::ostream& operator<<(std::ostream& os, const LatencyStats& s);
+
+// Mean work per query: "distances=.. candidates=.. unique=.. buckets=.. luts=.. adc=.. bytes=.. heap=.."
+std::string format_work(const SearchStats& total, std::size_t queries);
+
 struct EvalResults {
     double average_AF = 0.0;
     double recall_at_N = 0.0;
     double qps = 0.0;
     double tApproxAvg = 0.0;
     double tTrueAvg = 0.0;
+    LatencyStats approx_latency;
+    LatencyStats truth_latency;
+    // approx latencies per worker of run_parallel_search (empty with one thread)
+    std::vector<LatencyStats> approx_thread_latency;
+    // approx work (SearchResult::stats) summed over the queries
+    SearchStats approx_work;
+    std::size_t queries = 0;
 };
 
 EvalResults evaluate_results(
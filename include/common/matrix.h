@@ -0,0 +1,110 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+/*
+Row-major, 64-byte aligned storage for a set of fixed-dimension vectors.
+
+All rows live in one contiguous allocation, so scanning the dataset is a
+sequential walk through memory instead of a pointer chase over one heap
+block per vector. The row stride can optionally be padded up to a multiple
+of `pad_to` elements (e.g. 16 floats = one cache line) so that every row
+starts on an aligned boundary. Padding elements are always zero.
+*/
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+template <typename T>
+class Matrix {
+public:
+    static constexpr std::size_t kAlignment = 64;
+
+    Matrix() = default;
+
+    Matrix(std::size_t rows, std::size_t dim, std::size_t pad_to = 1)
+        : rows_(rows), dim_(dim), stride_(padded(dim, pad_to)) {
+        allocate();
+    }
+
+    // Storage left unwritten: the caller must fill every element, padding
+    // included. Pages then belong to the NUMA node of the writing thread.
+    struct Uninitialized {};
+    Matrix(std::size_t rows, std::size_t dim, std::size_t pad_to, Uninitialized)
+        : rows_(rows), dim_(dim), stride_(padded(dim, pad_to)) {
+        allocate(false);
+    }
+
+    Matrix(const Matrix& other)
+        : rows_(other.rows_), dim_(other.dim_), stride_(other.stride_) {
+        allocate();
+        if (size() > 0) std::memcpy(data_, other.data_, size() * sizeof(T));
+    }
+
+    Matrix(Matrix&& other) noexcept { swap(other); }
+
+    Matrix& operator=(Matrix other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    ~Matrix() { std::free(data_); }
+
+    void swap(Matrix& other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(rows_, other.rows_);
+        std::swap(dim_, other.dim_);
+        std::swap(stride_, other.stride_);
+    }
+
+    // number of vectors
+    std::size_t rows() const { return rows_; }
+    // logical dimension of every vector
+    std::size_t dim() const { return dim_; }
+    // distance (in elements) between two consecutive rows, dim() <= stride()
+    std::size_t stride() const { return stride_; }
+    std::size_t size() const { return rows_ * stride_; }
+    std::size_t bytes() const { return size() * sizeof(T); }
+    bool empty() const { return rows_ == 0; }
+
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+
+    T* row(std::size_t i) { return data_ + i * stride_; }
+    const T* row(std::size_t i) const { return data_ + i * stride_; }
+    T* operator[](std::size_t i) { return row(i); }
+    const T* operator[](std::size_t i) const { return row(i); }
+
+    // drop trailing rows (e.g. a truncated file); keeps the allocation
+    void truncate(std::size_t rows) {
+        if (rows < rows_) rows_ = rows;
+    }
+
+private:
+    T* data_ = nullptr;
+    std::size_t rows_ = 0;
+    std::size_t dim_ = 0;
+    std::size_t stride_ = 0;
+
+    static std::size_t padded(std::size_t dim, std::size_t pad_to) {
+        if (pad_to <= 1) return dim;
+        return (dim + pad_to - 1) / pad_to * pad_to;
+    }
+
+    void allocate(bool zero = true) {
+        std::size_t n = size() * sizeof(T);
+        if (n == 0) return;
+        // aligned_alloc requires the size to be a multiple of the alignment
+        n = (n + kAlignment - 1) / kAlignment * kAlignment;
+        data_ = static_cast<T*>(std::aligned_alloc(kAlignment, n));
+        if (!data_) throw std::bad_alloc();
+        if (zero) std::memset(static_cast<void*>(data_), 0, n);
+    }
+};
+
+using FloatMatrix = Matrix<float>;
+
+#endif // MATRIX_H
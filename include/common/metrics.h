@@ -2,6 +2,8 @@
 #define METRICS_H
 
 #include <vector>
+#include <cstddef>
+#include <cstdint>
 #include <cmath>
 #include <string>
 #include <stdexcept>
@@ -15,6 +17,125 @@ namespace metrics {
     double manhattan(const std::vector<double>& a, const std::vector<double>& b);
     double euclidean(const std::vector<double>& a, const std::vector<double>& b);
     double distance(const std::vector<double>& a, const std::vector<double>& b, const MetricConfig& cfg);
+
+    // Raw-pointer overloads for hot loops (dataset rows, centroids); no size checks
+    double manhattan(const float* a, const float* b, std::size_t dim);
+    double euclidean(const float* a, const float* b, std::size_t dim);
+    double distance(const float* a, const float* b, std::size_t dim, const MetricConfig& cfg);
+    double manhattan(const double* a, const double* b, std::size_t dim);
+    double euclidean(const double* a, const double* b, std::size_t dim);
+    double distance(const double* a, const double* b, std::size_t dim, const MetricConfig& cfg);
+    double distance(const std::uint8_t* a, const std::uint8_t* b, std::size_t dim, const MetricConfig& cfg);
+
+    // Comparison distance: monotonic in the true distance but cheaper (squared L2,
+    // plain L1). Rank and prune on it, square R once with to_comparison_distance,
+    // and convert only the reported hits back with to_true_distance.
+    double squared_euclidean(const float* a, const float* b, std::size_t dim);
+    double squared_euclidean(const double* a, const double* b, std::size_t dim);
+    double comparison_distance(const float* a, const float* b, std::size_t dim, const MetricConfig& cfg);
+    double comparison_distance(const double* a, const double* b, std::size_t dim, const MetricConfig& cfg);
+    double comparison_distance(const std::uint8_t* a, const std::uint8_t* b, std::size_t dim, const MetricConfig& cfg);
+    double comparison_distance(const std::vector<double>& a, const std::vector<double>& b, const MetricConfig& cfg);
+    double to_comparison_distance(double dist, const MetricConfig& cfg);
+    double to_true_distance(double cmp_dist, const MetricConfig& cfg);
+
+    // SIMD kernels are chosen once at startup from CPUID (widest supported level)
+    enum class SimdLevel { Scalar, SSE, AVX2, AVX512 };
+    SimdLevel detect_simd_level();
+    SimdLevel active_simd_level();
+    // force a narrower level (benchmarks / debugging); clamped to what the CPU supports
+    void set_simd_level(SimdLevel level);
+    const char* simd_level_name(SimdLevel level);
+
+    // Comparison kernels of the active SIMD level, for a fixed metric
+    using FloatKernel = double (*)(const float* a, const float* b, std::size_t dim);
+    using DoubleKernel = double (*)(const double* a, const double* b, std::size_t dim);
+    // out[r] = cmp(q, rows + r * stride) for r in [0, n): one call per block of rows
+    using FloatBatchKernel = void (*)(const float* q, const float* rows, std::size_t stride,
+                                      std::size_t n, std::size_t dim, double* out);
+    // Byte kernels compute in integers (exact): psadbw for L1, widening
+    // multiply-add (pmaddwd) of the differences for squared L2
+    using ByteKernel = double (*)(const std::uint8_t* a, const std::uint8_t* b, std::size_t dim);
+    using ByteBatchKernel = void (*)(const std::uint8_t* q, const std::uint8_t* rows, std::size_t stride,
+                                     std::size_t n, std::size_t dim, double* out);
+    // Blocked inner products for batched L2 (GEMM-style). A query panel packs
+    // kDotPanel queries interleaved: component k of query t is at [k * kDotPanel + t]
+    // (see pack_dot_panel). The kernel computes out[j * kDotPanel + t] = <query t, xs row j>
+    // for nx rows, accumulating in float with one SIMD lane per query.
+    constexpr std::size_t kDotPanel = 16;
+    using DotPanelKernel = void (*)(const float* panel, const float* xs, std::size_t x_stride,
+                                    std::size_t nx, std::size_t dim, float* out);
+    // One row against a panel (a matrix-vector product): out[t] = <query t, x>.
+    // The components are split over independent accumulator chains, so the sums
+    // are not bitwise equal to a DotPanelKernel's for the same row.
+    using DotPanelVecKernel = void (*)(const float* panel, const float* x, std::size_t dim, float* out);
+    // pack nq <= kDotPanel query rows into panel (dim * kDotPanel floats); missing lanes are zero
+    void pack_dot_panel(const float* qs, std::size_t q_stride, std::size_t nq, std::size_t dim, float* panel);
+    FloatKernel float_kernel(MetricType type);
+    DoubleKernel double_kernel(MetricType type);
+    FloatBatchKernel float_batch_kernel(MetricType type);
+    ByteKernel byte_kernel(MetricType type);
+    ByteBatchKernel byte_batch_kernel(MetricType type);
+    DotPanelKernel dot_panel_kernel();
+    DotPanelVecKernel dot_panel_vec_kernel();
+
+    // Float query against byte rows (a query that is not byte-valued): rows
+    // are widened a few at a time into a scratch buffer, then scanned by k
+    void widened_batch(FloatBatchKernel k, const float* q, const std::uint8_t* rows, std::size_t stride,
+                       std::size_t n, std::size_t dim, double* out);
+
+    /*
+    Compile-time metric for scan loops. The kernel pointers are resolved once
+    when the object is created, so a loop templated on Metric<M> has no metric
+    switch per candidate and the distance conversions inline away. Build one
+    per search (or batch) through dispatch().
+    */
+    template <MetricType M>
+    struct Metric {
+        static constexpr MetricType type = M;
+        FloatKernel f = float_kernel(M);
+        DoubleKernel d = double_kernel(M);
+        FloatBatchKernel batch = float_batch_kernel(M);
+        ByteKernel b8 = byte_kernel(M);
+        ByteBatchKernel batch8 = byte_batch_kernel(M);
+
+        double operator()(const float* a, const float* b, std::size_t dim) const { return f(a, b, dim); }
+        double operator()(const double* a, const double* b, std::size_t dim) const { return d(a, b, dim); }
+        double operator()(const std::uint8_t* a, const std::uint8_t* b, std::size_t dim) const {
+            return b8(a, b, dim);
+        }
+        double operator()(const std::vector<double>& a, const std::vector<double>& b) const {
+            return d(a.data(), b.data(), a.size());
+        }
+        void many(const float* q, const float* rows, std::size_t stride,
+                  std::size_t n, std::size_t dim, double* out) const {
+            batch(q, rows, stride, n, dim, out);
+        }
+        void many(const std::uint8_t* q, const std::uint8_t* rows, std::size_t stride,
+                  std::size_t n, std::size_t dim, double* out) const {
+            batch8(q, rows, stride, n, dim, out);
+        }
+        void many(const float* q, const std::uint8_t* rows, std::size_t stride,
+                  std::size_t n, std::size_t dim, double* out) const {
+            widened_batch(batch, q, rows, stride, n, dim, out);
+        }
+        static double to_true(double cmp_dist) {
+            if constexpr (M == MetricType::L2) return std::sqrt(cmp_dist);
+            else return cmp_dist;
+        }
+        static double to_comparison(double dist) {
+            if constexpr (M == MetricType::L2) return dist * dist;
+            else return dist;
+        }
+    };
+
+    // Call fn(Metric<M>{}) for the metric selected in cfg
+    template <typename Fn>
+    decltype(auto) dispatch(const MetricConfig& cfg, Fn&& fn) {
+        if (cfg.type == MetricType::L1) return fn(Metric<MetricType::L1>{});
+        return fn(Metric<MetricType::L2>{});
+    }
+
     MetricConfig parse_metric_type(const std::string& name);
     void set_global_config(const MetricConfig& cfg);
 }
@@ -0,0 +1,52 @@
+#ifndef VISITED_SET_H
+#define VISITED_SET_H
+
+/*
+Marks over ids [0, n), cleared in O(1), for deduplicating the candidates
+of one query.
+
+Every id stores the epoch in which it was last marked; clearing bumps the
+epoch instead of touching the array, which is zeroed again only when the
+counter wraps. for_thread() hands out one instance per thread, so the
+array is allocated once per thread instead of a hash set per query. An
+instance serves one query at a time.
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class VisitedSet {
+public:
+    // the calling thread's instance, sized for ids [0, n) and cleared
+    static VisitedSet& for_thread(std::size_t n) {
+        thread_local VisitedSet set;
+        set.clear(n);
+        return set;
+    }
+
+    // grow to ids [0, n) if needed and unmark every id
+    void clear(std::size_t n) {
+        if (marks_.size() < n) marks_.resize(n, 0);
+        if (++epoch_ == 0) {
+            std::fill(marks_.begin(), marks_.end(), 0);
+            epoch_ = 1;
+        }
+    }
+
+    // mark id; false if it was already marked since the last clear
+    bool insert(std::size_t id) {
+        if (marks_[id] == epoch_) return false;
+        marks_[id] = epoch_;
+        return true;
+    }
+
+    bool contains(std::size_t id) const { return marks_[id] == epoch_; }
+
+private:
+    std::vector<std::uint32_t> marks_;
+    std::uint32_t epoch_ = 0;
+};
+
+#endif // VISITED_SET_H
@@ -14,8 +14,31 @@
         - Algorithm (-algo): Algorithm to use (brute/dummy).
         - Distance Metric (-metric): Distance metric to use (l1/l2).
         - Threads (-threads): Number of threads for parallel execution.
+        - Batch (-batch): Queries handed to a thread at once (default 1);
+          IVFFlat, IVFPQ and BruteForce share work within a batch, which
+          leaves no per-query latency percentiles for the approx search.
         - N (-N): Number of nearest neighbors to search for.
         - R (-R): Search radius for range queries.
+        - Truth Cache (-truth_cache): Directory of cached ground truth
+          (default output/truth_cache, "none" disables it).
+        - Table Size (-table_size): LSH buckets per table, rounded up to a
+          power of two (default 0 = dataset size / 8).
+        - Probes per table (-T): LSH multi-probe, extra buckets visited per
+          table in order of likelihood (default 0 = plain LSH); query-time.
+        - Index (-index): file of the built index; loaded when it matches the
+          dataset, metric and build parameters, otherwise built and saved
+          there (not used by -sweep).
+        - Sweep (-sweep): Parameter sweep, e.g. "kclusters=64,256;nprobe=1,4,16;N=1,10".
+          Every combination of values is evaluated; one index is built per
+          combination of build-time parameters (see is_query_param).
+        - Output Format (-output_format): text (default) or binary: ids and
+          distances as <output>.ivecs/.fvecs (+ <output>.range), summary in <output>.
+        - Affinity (-affinity): none (default), compact, scatter or a CPU list
+          ("0,2,4-7") for the worker threads; see utils/numa.h.
+        - NUMA Nodes (-numa_nodes): emulated node layout, e.g. "0-3;4-7"
+          (default: the machine's, from /sys/devices/system/node).
+        - NUMA Replicate (-numa_replicate): true keeps one copy of the
+          BruteForce rows per node (default false).
     Currently Implemented Algorithms:
         - Brute-Force Search Algorithm (used as ground truth)
         - Dummy Search Algorithm (check parallel execution)
@@ -33,16 +56,26 @@ struct Args {
     std::string dataset_path, query_path, output_path;
     std::string type, algo, metric;
     int threads, N;
+    int batch = 1;
     double R;
     bool range = true;
     bool eval = true;
     bool interactive = true;
+    std::string truth_cache = "output/truth_cache";
+    std::string index_path;
+    std::string sweep;
+    std::string output_format = "text";
+    std::string affinity = "none";
+    std::string numa_nodes;
+    bool numa_replicate = false;
     std::string config_summary;
 
     // Algorithm-specific params
     int seed = 1;
     int k = 4, L = 5;             // LSH
-    double w = 4.0;
+    int table_size = 0;           // LSH buckets per table (0 = n / 8), rounded up to a power of two
+    int T = 0;                    // LSH multi-probe: extra buckets per table
+    double w = 600.0;             // LSH / Hypercube bucket width (prompt default 5000 for mnist)
     int kproj = 14, M = 10, probes = 2; // Hypercube
     int kclusters = 50, nprobe = 5;     // IVFFlat / IVFPQ
     int pq_M = 16, pq_nbits = 8;        // IVFPQ
@@ -50,4 +83,10 @@ struct Args {
 
 Args parse_args(int argc, char** argv);
 
+// Set the parameter behind a flag name without the dash ("nprobe", "L", "M", ...);
+// false if the name is unknown. Throws on a malformed value.
+bool set_arg(Args& args, const std::string& name, const std::string& value);
+// Whether a parameter only affects search (not build_index) for args.algo
+bool is_query_param(const Args& args, const std::string& name);
+
 #endif // ARGS_PARSER_H
\ No newline at end of file
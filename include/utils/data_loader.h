@@ -4,13 +4,64 @@
 #include <string>
 #include <vector>
 #include <iostream>
+#include <memory>
+#include <cstdint>
 
 #include "../algorithms/search_algorithm.h"
+#include "mapped_file.h"
 
 namespace data_loader {
 
-std::vector<Vector> load_dataset(const std::string& path, const std::string& type);
-std::vector<Vector> load_queries(const std::string& path, const std::string& type);
+// In-place view of a memory-mapped .fvecs/.ivecs/.bvecs file.
+// Record i is <int32 dim><dim x T>; row(i) points at its first component.
+template <typename T>
+struct VecsView {
+    std::shared_ptr<const MappedFile> file;
+    const unsigned char* first = nullptr;
+    size_t rows = 0;
+    size_t dim = 0;
+    size_t record_bytes = 0;
+
+    const T* row(size_t i) const { return reinterpret_cast<const T*>(first + i * record_bytes); }
+};
+
+// In-place view of a memory-mapped IDX image file (MNIST): a 16-byte
+// big-endian header followed by `count` images of rows*cols bytes
+struct IdxView {
+    std::shared_ptr<const MappedFile> file;
+    const unsigned char* pixels = nullptr;
+    size_t count = 0;
+    size_t rows = 0;
+    size_t cols = 0;
+
+    const unsigned char* image(size_t i) const { return pixels + i * rows * cols; }
+};
+
+// T = float (fvecs), int32_t (ivecs) or uint8_t (bvecs)
+template <typename T>
+VecsView<T> map_vecs(const std::string& path);
+IdxView map_idx(const std::string& path);
+
+// --- Sharded files ---
+// Shape of a .fvecs/.bvecs file or of a directory of shard parts
+struct VecsInfo {
+    std::vector<std::string> shards; // in id order
+    std::vector<size_t> shard_rows;
+    size_t rows = 0;
+    size_t dim = 0;
+};
+
+// path is a single .fvecs/.bvecs file or a directory whose *.fvecs/*.bvecs
+// parts are concatenated in file name order; all parts must share one dimension
+VecsInfo probe_vecs(const std::string& path);
+
+// Datasets are returned as a shared read-only handle that every index borrows.
+// Single .fvecs/.bvecs files are used in place (zero-copy); MNIST and .bvecs
+// keep uint8 elements. Sharded directories are decoded in parallel on
+// `threads` workers into float32.
+Dataset load_dataset(const std::string& path, const std::string& type, int threads = 1);
+// Queries keep the per-vector layout expected by SearchAlgorithm::search
+std::vector<Vector> load_queries(const std::string& path, const std::string& type, int threads = 1);
 
 }
 
@@ -0,0 +1,42 @@
+#ifndef FNV_H
+#define FNV_H
+
+/*
+64-bit FNV-1a, shared by the index fingerprint (index_io) and the truth
+cache keys (truth_cache). Both variants take the running hash, so several
+buffers can be chained into one value.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace fnv {
+
+constexpr std::uint64_t kOffset = 0xcbf29ce484222325ULL;
+constexpr std::uint64_t kPrime = 0x100000001b3ULL;
+
+// one byte per step (the reference FNV-1a)
+inline std::uint64_t hash_bytes(const void* data, std::size_t n, std::uint64_t h = kOffset) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < n; ++i) h = (h ^ p[i]) * kPrime;
+    return h;
+}
+
+// 8-byte words (tail bytes one at a time), then the length: eight times
+// fewer multiplies for whole files
+inline std::uint64_t hash_words(const void* data, std::size_t n, std::uint64_t h = kOffset) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        std::uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        h = (h ^ w) * kPrime;
+    }
+    for (; i < n; ++i) h = (h ^ p[i]) * kPrime;
+    return (h ^ n) * kPrime;
+}
+
+} // namespace fnv
+
+#endif // FNV_H
@@ -0,0 +1,126 @@
+#ifndef INDEX_IO_H
+#define INDEX_IO_H
+
+/*
+Binary files of built indexes (SearchAlgorithm::save_index / load_index).
+
+Layout, all little-endian, written by Writer and read back by Reader:
+
+    header    magic "ANNIDX\0\0", format version, algorithm name (16 bytes),
+              dataset rows / dim, metric, dataset fingerprint
+    body      the algorithm's build parameters, then its arrays in a fixed
+              order; every array is a uint64 element count followed by the
+              raw elements, starting on a 64-byte boundary of the file
+
+The body is not parsed: Reader maps the file (MappedFile) and hands out
+the arrays in place (view) or copies them (array); an index that keeps
+views holds on to mapping() so they outlive the Reader. Nothing derived from
+the dataset rows themselves is stored. Loading needs the same dataset: the
+header pins its shape and a fingerprint of sampled rows, and the
+parameters must match the configured ones. Any mismatch, a different
+version or a truncated file throws std::runtime_error.
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../common/dataset.h"
+#include "mapped_file.h"
+
+namespace index_io {
+
+constexpr std::uint32_t kVersion = 5; // 2: LSH tables as CSR, 3: E2LSH projections, 4: LSH keys, 5: IVFPQ lists as CSR
+
+// FNV-1a over the shape and up to 1024 evenly spaced rows, hashed as float
+// values so a byte dataset matches its widened() copy
+std::uint64_t fingerprint(const Dataset& dataset);
+
+class Writer {
+public:
+    // starts `path`.tmp.<pid> and writes the header; finish() moves it into place
+    Writer(const std::string& path, const std::string& algo, const Dataset& dataset);
+
+    template <typename T>
+    void put(const T& value) {
+        write(&value, sizeof(T));
+    }
+
+    template <typename T>
+    void array(const T* data, std::uint64_t count) {
+        put(count);
+        pad();
+        write(data, count * sizeof(T));
+    }
+
+    template <typename T>
+    void array(const std::vector<T>& values) {
+        array(values.data(), values.size());
+    }
+
+    void finish();
+
+private:
+    std::string path_, tmp_;
+    std::ofstream out_;
+    std::uint64_t pos_ = 0;
+
+    void write(const void* data, std::uint64_t bytes);
+    void pad(); // zeros up to the next 64-byte boundary
+};
+
+class Reader {
+public:
+    // maps `path` and checks the header against the algorithm and dataset
+    Reader(const std::string& path, const std::string& algo, const Dataset& dataset);
+
+    template <typename T>
+    T get() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    // reads a build parameter; throws if the index was built with another value
+    template <typename T>
+    void expect(const T& configured, const char* name) {
+        if (get<T>() != configured)
+            throw std::runtime_error(std::string("index was built with a different ") + name);
+    }
+
+    // the next array, in place in the mapping (valid while the Reader or a
+    // copy of mapping() lives)
+    template <typename T>
+    std::pair<const T*, std::uint64_t> view() {
+        const std::uint64_t count = get<std::uint64_t>();
+        align();
+        if (count > (file_->size() - pos_) / sizeof(T)) throw std::runtime_error("truncated index file");
+        const T* data = reinterpret_cast<const T*>(take(count * sizeof(T)));
+        return {data, count};
+    }
+
+    template <typename T>
+    std::vector<T> array() {
+        const auto [data, count] = view<T>();
+        return std::vector<T>(data, data + count);
+    }
+
+    // owner of the mapping behind every view()
+    std::shared_ptr<const void> mapping() const { return file_; }
+
+private:
+    std::shared_ptr<const MappedFile> file_;
+    std::uint64_t pos_ = 0;
+
+    const unsigned char* take(std::uint64_t bytes);
+    void align();
+};
+
+} // namespace index_io
+
+#endif // INDEX_IO_H
@@ -0,0 +1,35 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+/*
+Read-only memory mapping of a whole file.
+
+The file is exposed in place: pages are faulted in lazily on first access
+and live in the page cache, so concurrent runs over the same dataset share
+them. The kernel is told the access pattern (sequential, needed soon) right
+after mapping. Throws std::runtime_error if the file cannot be opened or
+mapped.
+*/
+
+#include <cstddef>
+#include <string>
+
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+    const unsigned char* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+#endif // MAPPED_FILE_H
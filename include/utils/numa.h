@@ -0,0 +1,99 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+/*
+NUMA-aware thread placement and dataset placement.
+
+The topology (CPUs of every memory node) is read from
+/sys/devices/system/node, or taken from -numa_nodes, which emulates a
+layout on any machine, e.g. "0-3;4-7" = two nodes of four CPUs, or "0;0"
+= two nodes sharing CPU 0. CPUs outside this process's affinity mask are
+dropped.
+
+-affinity pins the slots of the shared ThreadPool (slot 0 = main thread):
+    none     leave placement to the OS (default)
+    compact  fill the CPUs of node 0 first, then node 1, ...
+    scatter  round-robin over nodes
+    <list>   explicit CPUs, e.g. "0,2,4-7"; slot s runs on list[s % size]
+
+Memory goes to the node of the thread that first touches it. With
+placement active and more than one node, the dataset is therefore copied
+once by the pinned workers, each writing a block of rows (first_touch), so
+its pages are spread over the nodes instead of all sitting on the loader's
+node. With -numa_replicate true, BruteForce also keeps one copy per node
+(replicate) and every thread scans the copy local to it. On a single node
+both steps are skipped; pinning failures print a warning and fall back to
+unpinned threads.
+
+Index arrays are spread the same way, without copies: the IVFFlat list
+blocks, the IVFPQ list ids/codes and the LSH tables are allocated and
+written by the pool threads (one list or table per task), so they land on
+the nodes of the threads that built them. Not covered: the Hypercube
+buckets (built on the main thread) and IVFPQ lists used in place from an
+index file, whose pages sit wherever the page cache read them.
+*/
+
+#include <string>
+#include <vector>
+
+#include "../common/dataset.h"
+#include "args_parser.h"
+
+namespace numa {
+
+struct Topology {
+    std::vector<std::vector<int>> node_cpus; // CPUs of node n
+
+    int nodes() const { return static_cast<int>(node_cpus.size()); }
+    int node_of(int cpu) const; // 0 if the CPU is on no node
+};
+
+// "0,2,4-7" -> {0, 2, 4, 5, 6, 7}; throws std::runtime_error on bad syntax
+std::vector<int> parse_cpu_list(const std::string& list);
+// ";"-separated CPU lists, one per emulated node
+Topology parse_topology(const std::string& spec);
+// Nodes of this machine (one node with every allowed CPU if sysfs has none)
+Topology detect_topology();
+
+// CPU and node of every pool slot; empty when placement is left to the OS
+struct Placement {
+    std::vector<int> cpus;
+    std::vector<int> nodes;
+
+    bool active() const { return !cpus.empty(); }
+};
+
+Placement plan_placement(const Topology& topology, const std::string& policy, int threads);
+
+// Pin the calling thread to one CPU; false if the OS refuses
+bool pin_current_thread(int cpu);
+
+// Node of the calling thread: set for pinned pool slots, 0 otherwise
+int current_node();
+void set_current_node(int node);
+
+// Topology and placement from args (-affinity, -numa_nodes), installed
+// into the shared ThreadPool; logs the layout
+void configure(const Args& args);
+
+// Nodes that have at least one pinned slot among the first `threads` (1 if unpinned)
+int active_nodes(int threads);
+
+// The dataset rows copied by the pinned slots, block by block (first-touch
+// spread over the nodes); `dataset` itself when there is a single node
+Dataset first_touch(const Dataset& dataset, int threads);
+
+// One copy of the dataset per active node, each written by that node's
+// slots; empty when there is a single node
+std::vector<Dataset> replicate(const Dataset& dataset, int threads);
+
+// The replica for the calling thread's node, or `shared` without replicas
+inline const Dataset& local(const std::vector<Dataset>& replicas, const Dataset& shared) {
+    const int node = current_node();
+    if (node < 0 || node >= static_cast<int>(replicas.size()) || replicas[node].empty()) return shared;
+    return replicas[node];
+}
+
+} // namespace numa
+
+#endif // NUMA_H
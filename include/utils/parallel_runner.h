@@ -5,11 +5,15 @@
 
 #include "../algorithms/search_algorithm.h"
 
+// Answers every query on num_threads threads of the shared pool. Threads
+// take `batch` consecutive queries at a time and run them through
+// algo->search_batch; batch 1 calls search() per query.
 std::vector<SearchResult> run_parallel_search(
     const SearchAlgorithm* algo,
     const std::vector<Vector>& queries,
     int num_threads,
-    const Params& params
+    const Params& params,
+    int batch = 1
 );
 
 #endif // PARALLEL_RUNNER_H
\ No newline at end of file
@@ -1,17 +1,40 @@
 #ifndef RESULT_WRITER_H
 #define RESULT_WRITER_H
 
+/*
+Result output.
+
+Text mode writes the configuration/evaluation summary followed by every
+query's neighbours to `path`. Queries are formatted in parallel (std::to_chars,
+one buffer per worker) a batch at a time and written in query order.
+
+Binary mode writes only the summary to `path`, and the results next to it:
+    <path>.ivecs       neighbour ids, one record per query
+    <path>.fvecs       approximate distances
+    <path>.true.fvecs  true distances (when truth results are given)
+    <path>.range       range hits in CSR form (when any query has range results):
+                       uint64 nq, uint64 nnz, uint64 offsets[nq + 1],
+                       int32 ids[nnz], float distances[nnz]
+ivecs/fvecs records are an int32 count followed by count values.
+*/
+
 #include <vector>
 #include <string>
 
 #include "../algorithms/search_algorithm.h"
 #include "../common/evaluation_metrics.h"
 
+struct WriteOptions {
+    bool binary = false;
+    int threads = 1; // text formatting workers
+};
+
 void write_results(const std::vector<SearchResult>& results, 
                    const std::string& path, 
                    const std::string& method_name,
                    double approx_time_ms = 0.0,
                    const std::string& config_summary = {},
                    const std::vector<SearchResult>* truth_results = nullptr,
-                   const EvalResults* eval_summary = nullptr);
-#endif // RESULT_WRITER_H
\ No newline at end of file
+                   const EvalResults* eval_summary = nullptr,
+                   const WriteOptions& options = {});
+#endif // RESULT_WRITER_H
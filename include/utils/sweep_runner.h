@@ -0,0 +1,24 @@
+#ifndef SWEEP_RUNNER_H
+#define SWEEP_RUNNER_H
+
+/*
+Parameter sweep in a single process.
+
+The spec (-sweep) is a list of axes "name=v1,v2,...;name=..." using the flag
+names without the dash. Every combination of values is evaluated against one
+ground truth (computed at the largest N; with range search on, one per swept R). Build-time axes (kclusters, L, k,
+...) get one index per combination; query-time axes (nprobe, probes, N, ...)
+reuse the built index through SearchAlgorithm::set_search_params, so a whole
+recall/QPS curve costs one build per build point.
+
+One row per combination is printed and written to args.output_path.
+*/
+
+#include <vector>
+
+#include "args_parser.h"
+#include "../algorithms/search_algorithm.h"
+
+int run_sweep(const Args& args, const Dataset& dataset, const std::vector<Vector>& queries);
+
+#endif // SWEEP_RUNNER_H
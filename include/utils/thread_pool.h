@@ -0,0 +1,99 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+/*
+Persistent fork-join thread pool with work stealing.
+
+Workers are started once and sleep between jobs, so a parallel loop costs a
+wake-up instead of a thread spawn. A job over [0, count) is cut into one
+contiguous range per participant (the caller is participant 0). Each
+participant pops chunks of `grain` indices off the front of its own range;
+when that is empty it steals the back half of another participant's range.
+Every range has its own lock, so cheap iterations do not all fight over one
+shared counter, and expensive ones still spread evenly.
+
+Slots can be pinned to CPUs (set_placement, see numa.h); each worker
+re-pins itself at the start of its next job after the placement changes.
+
+A job started while the pool is already running one (a nested loop, or a
+second caller thread) runs serially on the calling thread. The first
+exception thrown by `fn` stops the job and is rethrown to the caller.
+*/
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    // fn(begin, end, slot): one chunk [begin, end), run by participant `slot`
+    using RangeFn = std::function<void(std::size_t, std::size_t, int)>;
+
+    // Process-wide pool shared by search, index construction and output
+    static ThreadPool& instance();
+
+    ThreadPool() = default;
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Run fn over [0, count) on min(threads, count) participants; slots are
+    // 0 .. participants-1. grain 0 picks a chunk size from count and threads.
+    void run(std::size_t count, int threads, std::size_t grain, const RangeFn& fn);
+
+    // fn(slot) exactly once on each of `threads` participants, without
+    // stealing, so per-slot work (e.g. first-touch copies) stays on its CPU
+    void run_per_slot(int threads, const std::function<void(int)>& fn);
+
+    // Slot s runs on cpus[s % size] (node nodes[s % size]); empty = unpinned.
+    // Pins the calling thread, which becomes slot 0, right away.
+    void set_placement(std::vector<int> cpus, std::vector<int> nodes);
+
+private:
+    struct alignas(64) Slot {
+        std::mutex m;
+        std::size_t lo = 0, hi = 0; // indices still owned by this participant
+    };
+
+    void grow(int participants);
+    void start(std::size_t count, int threads, std::size_t grain, bool steal, const RangeFn& fn);
+    void apply_placement(int slot);
+    void work(int slot);
+    bool pop_chunk(int slot, std::size_t& lo, std::size_t& hi);
+    bool steal(int slot);
+
+    std::vector<std::thread> workers_; // worker w is slot w + 1
+    std::vector<std::unique_ptr<Slot>> slots_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_, done_;
+    bool busy_ = false, stop_ = false;
+    std::uint64_t generation_ = 0; // bumped for every job
+    int participants_ = 0;         // slots taking part in the current job
+    int running_ = 0;              // workers still inside the current job
+    std::size_t grain_ = 1;
+    bool steal_ = true;
+    std::vector<int> cpus_, nodes_;
+    std::uint64_t placement_generation_ = 0;
+    const RangeFn* job_ = nullptr;
+    std::exception_ptr error_;
+    std::atomic<bool> failed_{false}; // set with error_; participants stop claiming chunks
+};
+
+// fn(i, slot) for i in [0, count) on up to `threads` threads of the shared pool
+template <typename Fn>
+void parallel_for(std::size_t count, int threads, Fn&& fn, std::size_t grain = 0) {
+    ThreadPool::instance().run(count, threads, grain, [&fn](std::size_t lo, std::size_t hi, int slot) {
+        for (std::size_t i = lo; i < hi; ++i) fn(i, slot);
+    });
+}
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,61 @@
+#ifndef TRUTH_CACHE_H
+#define TRUTH_CACHE_H
+
+/*
+Persistent cache of BruteForce ground truth.
+
+Truth depends only on the dataset, the queries, the metric, N and R, never
+on the approximate algorithm, so it is computed once and reused by later
+runs. Entries live in one directory as ivecs/fvecs files (one record per
+query, in query order):
+
+    gt_<key>_knn<N>.ivecs       neighbour ids, N per record (fewer if the dataset is smaller)
+    gt_<key>_knn<N>.fvecs       their distances
+    gt_<key>_knn<N>.time.fvecs  per-query search time of the run that produced them (ms),
+                                followed by 1 if it is a share of a batch (shared_time)
+    gt_<key>_r<R>.ivecs/.fvecs  range results for radius R (bit pattern in hex)
+
+<key> combines the content hashes of the dataset and query files, the
+dataset type and the metric. A request for N is served by the smallest
+cached N' >= N, truncated: the first N of N' neighbours are the top N.
+*/
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../algorithms/search_algorithm.h"
+#include "args_parser.h"
+
+namespace truth_cache {
+
+struct Key {
+    std::uint64_t data_hash = 0;
+    std::uint64_t query_hash = 0;
+    std::string type;
+    std::string metric; // "l1" / "l2"
+    int N = 1;
+    double R = 0.0;
+    bool range = false; // range results are part of the entry
+};
+
+// 64-bit content hash of a file, or of all regular files of a directory in name order
+std::uint64_t hash_path(const std::string& path);
+
+// Fill `out` (n_queries results) from the cache; false if no matching entry
+bool load(const std::string& dir, const Key& key, std::size_t n_queries, std::vector<SearchResult>& out);
+
+// Write the entry for `key`; files are replaced atomically
+void store(const std::string& dir, const Key& key, const std::vector<SearchResult>& results);
+
+// Truth for (dataset, queries, params): from the cache in args.truth_cache if
+// possible, otherwise computed with BruteForce on args.threads threads and
+// cached. truth_time_ms is the (original) wall time of the truth search.
+// After a tiled batch (shared_time), up to 1000 evenly spaced queries are
+// re-run one by one so they carry their own latency.
+std::vector<SearchResult> get_truth(const Args& args, const Dataset& dataset, const std::vector<Vector>& queries,
+                                    const Params& params, double& truth_time_ms);
+
+} // namespace truth_cache
+
+#endif // TRUTH_CACHE_H
@@ -10,57 +10,112 @@
 #include "../../include/algorithms/brute_force_search.h"
 #include "../../include/utils/args_parser.h"
 #include "../../include/common/metrics.h"
+#include "../../include/utils/thread_pool.h"
+#include "../../include/utils/numa.h"
 
 using namespace std::chrono;
 
-void BruteForceSearch::build_index(const std::vector<Vector>& dataset) {
+void BruteForceSearch::configure(const Args& args) {
+    numa_replicate_ = args.numa_replicate;
+    threads_ = args.threads;
+}
+
+void BruteForceSearch::build_index(const Dataset& dataset) {
     feature_vectors = dataset;
-    n_points = dataset.empty() ? 0 : static_cast<int>(dataset.size());
-    space_dim = dataset.empty() ? 0 : static_cast<int>(dataset.front().values.size());
+    n_points = static_cast<int>(dataset.rows());
+    space_dim = dataset.empty() ? 0 : static_cast<int>(dataset.dim());
+
+    norms_.clear();
+    max_norm_ = 0.0f;
+    if (!dataset.is_bytes()) {
+        const std::vector<float> zero(space_dim, 0.0f);
+        norms_.resize(n_points);
+        for (int i = 0; i < n_points; ++i) {
+            norms_[i] = static_cast<float>(metrics::squared_euclidean(dataset[i], zero.data(), space_dim));
+            max_norm_ = std::max(max_norm_, norms_[i]);
+        }
+    }
+    replicas_.clear();
+    if (numa_replicate_) replicas_ = numa::replicate(feature_vectors, threads_);
     std::cout << "[BruteForce] built index with " << n_points << " points (dim=" << space_dim << ")\n";
 }
 
 
 SearchResult BruteForceSearch::search(const Vector& query, const Params& params, int query_id) const {
+    return metrics::dispatch(metrics::GLOBAL_METRIC_CFG, [&](const auto& metric) {
+        return search_impl(metric, query, params, query_id);
+    });
+}
+
+template <typename Metric>
+SearchResult BruteForceSearch::search_impl(const Metric& metric, const Vector& query, const Params& params, int query_id) const {
     using namespace std::chrono;
     auto t0 = high_resolution_clock::now();
 
     SearchResult res;
     res.query_id = query_id;
-    if (n_points == 0) return res;
+    if (n_points == 0 || static_cast<int>(query.values.size()) != space_dim) return res;
 
     const int N = params.N;
     const bool do_range = params.enable_range && params.R > 0.0;
+    // rank on the comparison distance (squared L2), R is squared once here
+    const double R_cmp = Metric::to_comparison(params.R);
 
     // Use a fixed-size max-heap to keep top-N smallest distances
-    std::priority_queue<std::pair<double, int>> topN; // (distance, id)
-
-    for (int i = 0; i < n_points; ++i) {
-        double dist = metrics::distance(
-            query.values,
-            feature_vectors[i].values,
-            metrics::GLOBAL_METRIC_CFG
-        );
-
-        if ((int)topN.size() < N) {
-            topN.emplace(dist, i);
-        } else if (dist < topN.top().first) {
-            topN.pop();
-            topN.emplace(dist, i);
-        }
+    std::priority_queue<std::pair<double, int>> topN; // (comparison distance, id)
+
+    // distances are computed a block of consecutive rows at a time
+    constexpr int kBlock = 256;
+    double block_dist[kBlock];
+
+    // byte datasets are scanned with the integer kernels when the query is
+    // byte-valued too, otherwise rows are widened block by block
+    const std::vector<float> q = to_float(query);
+    std::vector<uint8_t> qb;
+    const bool bytes = feature_vectors.is_bytes();
+    const bool byte_query = bytes && to_bytes(query, qb);
+    const Dataset& rows = numa::local(replicas_, feature_vectors);
+    const size_t stride = rows.stride();
+
+    for (int start = 0; start < n_points; start += kBlock) {
+        const int count = std::min(kBlock, n_points - start);
+        if (byte_query)
+            metric.many(qb.data(), rows.byte_row(start), stride, count, space_dim, block_dist);
+        else if (bytes)
+            metric.many(q.data(), rows.byte_row(start), stride, count, space_dim, block_dist);
+        else
+            metric.many(q.data(), rows[start], stride, count, space_dim, block_dist);
 
-        if (do_range && dist <= params.R) {
-            res.range_neighbor_ids.push_back(i);
-            res.range_distances.push_back(static_cast<float>(dist));
+        for (int j = 0; j < count; ++j) {
+            const double dist = block_dist[j];
+            const int i = start + j;
+
+            if ((int)topN.size() < N) {
+                topN.emplace(dist, i);
+                ++res.stats.heap_operations;
+            } else if (dist < topN.top().first) {
+                topN.pop();
+                topN.emplace(dist, i);
+                res.stats.heap_operations += 2;
+            }
+
+            if (do_range && dist <= R_cmp) {
+                res.range_neighbor_ids.push_back(i);
+                res.range_distances.push_back(static_cast<float>(Metric::to_true(dist)));
+            }
         }
     }
 
+    // every row is a candidate and gets one distance
+    res.stats.distance_computations = res.stats.candidates = res.stats.unique_candidates = n_points;
+    res.stats.bytes_scanned = static_cast<std::uint64_t>(n_points) * space_dim * feature_vectors.elem_size();
+
     // Extract and sort final results
     res.neighbor_ids.resize(topN.size());
     res.distances.resize(topN.size());
     for (int i = (int)topN.size() - 1; i >= 0; --i) {
         res.neighbor_ids[i] = topN.top().second;
-        res.distances[i] = static_cast<float>(topN.top().first);
+        res.distances[i] = static_cast<float>(Metric::to_true(topN.top().first));
         topN.pop();
     }
 
@@ -68,3 +123,183 @@ SearchResult BruteForceSearch::search(const Vector& query, const Params& params,
     res.time_ms = duration<double, std::milli>(t1 - t0).count();
     return res;
 }
+
+namespace {
+
+constexpr size_t kQueryTile = 4 * metrics::kDotPanel; // queries per work item (4 panels, in L1/L2)
+constexpr size_t kBaseTile = 256;  // base rows per dot-product tile
+constexpr size_t kSlack = 8;       // candidates kept beyond N, re-ranked exactly
+
+// what one (query, base part) work item found
+struct Candidates {
+    std::vector<std::pair<float, int>> heap; // max-heap on approximate distance, K entries at most
+    std::vector<int> range_ids;              // approximate distance within R (+ error bound)
+    std::uint64_t heap_operations = 0;
+};
+
+} // namespace
+
+std::vector<SearchResult> BruteForceSearch::search_batch(const Vector* queries, size_t nq, const Params& params,
+                                                         int num_threads) const {
+    std::vector<SearchResult> results(nq);
+    num_threads = std::max(1, num_threads);
+
+    const bool tiled = metrics::GLOBAL_METRIC_CFG.type == metrics::MetricType::L2 && !feature_vectors.is_bytes()
+                       && n_points > 0 && params.N > 0 && nq > 0;
+    if (!tiled) {
+        parallel_for(nq, num_threads, [&](size_t i, int) { results[i] = search(queries[i], params, static_cast<int>(i)); });
+        return results;
+    }
+
+    auto t0 = high_resolution_clock::now();
+    const size_t dim = space_dim;
+    const size_t n = n_points;
+    const size_t K = params.N + kSlack;
+    const bool do_range = params.enable_range && params.R > 0.0;
+    const double R_cmp = params.R * params.R;
+    // |approximate - exact| <= tol * (||q||^2 + ||x||^2): worst-case rounding of
+    // the float norms, of a dim-term float dot product and of combining them
+    const double tol = (dim + 4) * double(std::numeric_limits<float>::epsilon());
+
+    // queries as float rows (a query of the wrong size gets an empty result),
+    // then interleaved into panels of kDotPanel for the dot-product kernel
+    constexpr size_t P = metrics::kDotPanel;
+    FloatMatrix Q(nq, dim);
+    std::vector<float> qnorm(nq, 0.0f);
+    std::vector<bool> valid(nq);
+    const std::vector<float> zero(dim, 0.0f);
+    for (size_t i = 0; i < nq; ++i) {
+        valid[i] = queries[i].values.size() == dim;
+        results[i].query_id = static_cast<int>(i);
+        if (!valid[i]) continue;
+        std::copy(queries[i].values.begin(), queries[i].values.end(), Q[i]);
+        qnorm[i] = static_cast<float>(metrics::squared_euclidean(Q[i], zero.data(), dim));
+    }
+    const size_t n_panels = (nq + P - 1) / P;
+    FloatMatrix panels(n_panels, dim * P);
+    for (size_t p = 0; p < n_panels; ++p)
+        metrics::pack_dot_panel(Q[p * P], Q.stride(), std::min(P, nq - p * P), dim, panels[p]);
+
+    // Work items are (query tile, base part). The base is split only as far as
+    // needed to keep every thread busy; each part fills its own heaps, which
+    // are merged per query afterwards.
+    const size_t q_tiles = (nq + kQueryTile - 1) / kQueryTile;
+    const size_t base_tiles = (n + kBaseTile - 1) / kBaseTile;
+    const size_t parts = std::min(base_tiles, std::max<size_t>(1, (2 * num_threads + q_tiles - 1) / q_tiles));
+    const size_t part_rows = (base_tiles + parts - 1) / parts * kBaseTile;
+
+    std::vector<Candidates> found(nq * parts);
+    std::vector<double> item_ms(q_tiles * parts, 0.0);
+    const metrics::DotPanelKernel dot_panel = metrics::dot_panel_kernel();
+
+    parallel_for(q_tiles * parts, num_threads, [&](size_t item, int) {
+        auto w0 = high_resolution_clock::now();
+        const size_t qt = item / parts, part = item % parts;
+        const size_t q_begin = qt * kQueryTile, q_count = std::min(kQueryTile, nq - q_begin);
+        const size_t b_begin = part * part_rows, b_end = std::min(n, b_begin + part_rows);
+        std::vector<float> dots(kBaseTile * P);
+        const Dataset& rows = numa::local(replicas_, feature_vectors);
+        auto by_dist = [](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a < b; };
+
+        for (size_t b0 = b_begin; b0 < b_end; b0 += kBaseTile) {
+            const size_t nb = std::min(kBaseTile, b_end - b0);
+            for (size_t p0 = q_begin; p0 < q_begin + q_count; p0 += P) {
+                dot_panel(panels[p0 / P], rows[b0], rows.stride(), nb, dim, dots.data());
+
+                for (size_t t = 0; t < P && p0 + t < q_begin + q_count; ++t) {
+                    const size_t qi = p0 + t;
+                    if (!valid[qi]) continue;
+                    Candidates& c = found[qi * parts + part];
+                    const float qn = qnorm[qi];
+                    const float range_cut = static_cast<float>(R_cmp + tol * qn);
+                    float worst = c.heap.size() < K ? std::numeric_limits<float>::infinity() : c.heap.front().first;
+                    for (size_t j = 0; j < nb; ++j) {
+                        const size_t id = b0 + j;
+                        const float approx = qn + norms_[id] - 2.0f * dots[j * P + t];
+                        if (approx < worst) {
+                            if (c.heap.size() == K) std::pop_heap(c.heap.begin(), c.heap.end(), by_dist), c.heap.pop_back(), ++c.heap_operations;
+                            c.heap.emplace_back(approx, static_cast<int>(id));
+                            std::push_heap(c.heap.begin(), c.heap.end(), by_dist);
+                            ++c.heap_operations;
+                            if (c.heap.size() == K) worst = c.heap.front().first;
+                        }
+                        if (do_range && approx - float(tol) * norms_[id] <= range_cut)
+                            c.range_ids.push_back(static_cast<int>(id));
+                    }
+                }
+            }
+        }
+        item_ms[item] = duration<double, std::milli>(high_resolution_clock::now() - w0).count();
+    });
+
+    // Merge: exact distances for the surviving candidates, then the N best by
+    // (distance, id) as in search(). If a full heap's cut-off lies within the
+    // error bound of the N-th distance, a point outside it could still belong
+    // to the top N, so that query is answered by the exact scan instead.
+    const metrics::Metric<metrics::MetricType::L2> metric;
+    parallel_for(nq, num_threads, [&](size_t qi, int) {
+        auto m0 = high_resolution_clock::now();
+        SearchResult& res = results[qi];
+        // the tiles are shared by up to kQueryTile queries: each gets an even
+        // share of its tile's time, plus its own merge below
+        const size_t qt = qi / kQueryTile, tile_queries = std::min(kQueryTile, nq - qt * kQueryTile);
+        for (size_t part = 0; part < parts; ++part) res.time_ms += item_ms[qt * parts + part] / tile_queries;
+        res.shared_time = true;
+        if (!valid[qi]) return;
+        const float* q = Q[qi];
+        const Dataset& rows = numa::local(replicas_, feature_vectors);
+
+        // one dot product per row, then exact distances for the re-ranked candidates
+        res.stats.candidates = res.stats.unique_candidates = n;
+        res.stats.distance_computations = n;
+        res.stats.bytes_scanned = n * dim * sizeof(float);
+        std::vector<std::pair<double, int>> exact;
+        for (size_t part = 0; part < parts; ++part) {
+            for (const auto& cand : found[qi * parts + part].heap)
+                exact.emplace_back(metric(q, rows[cand.second], dim), cand.second);
+            res.stats.heap_operations += found[qi * parts + part].heap_operations;
+        }
+        res.stats.distance_computations += exact.size();
+        res.stats.bytes_scanned += exact.size() * dim * sizeof(float);
+        const size_t topK = std::min<size_t>(params.N, exact.size());
+        std::partial_sort(exact.begin(), exact.begin() + topK, exact.end());
+
+        const double bound = tol * (double(qnorm[qi]) + max_norm_);
+        bool safe = true;
+        for (size_t part = 0; part < parts && topK > 0; ++part) {
+            const Candidates& c = found[qi * parts + part];
+            if (c.heap.size() == K && c.heap.front().first - bound <= exact[topK - 1].first) safe = false;
+        }
+        if (!safe) {
+            const double spent = res.time_ms;
+            const SearchStats spent_work = res.stats;
+            res = search(queries[qi], params, static_cast<int>(qi));
+            res.time_ms = spent + duration<double, std::milli>(high_resolution_clock::now() - m0).count();
+            res.stats += spent_work;
+            res.shared_time = true;
+            return;
+        }
+
+        for (size_t i = 0; i < topK; ++i) {
+            res.neighbor_ids.push_back(exact[i].second);
+            res.distances.push_back(static_cast<float>(metric.to_true(exact[i].first)));
+        }
+        if (do_range) {
+            for (size_t part = 0; part < parts; ++part)
+                for (int id : found[qi * parts + part].range_ids) {
+                    const double d = metric(q, rows[id], dim);
+                    ++res.stats.distance_computations;
+                    res.stats.bytes_scanned += dim * sizeof(float);
+                    if (d <= R_cmp) {
+                        res.range_neighbor_ids.push_back(id);
+                        res.range_distances.push_back(static_cast<float>(metric.to_true(d)));
+                    }
+                }
+        }
+        res.time_ms += duration<double, std::milli>(high_resolution_clock::now() - m0).count();
+    });
+
+    std::cout << "[BruteForce] batched " << nq << " queries in " << q_tiles << "x" << parts << " tiles ("
+              << duration<double>(high_resolution_clock::now() - t0).count() << " sec)\n";
+    return results;
+}
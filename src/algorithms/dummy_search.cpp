@@ -24,9 +24,9 @@ Example of correct output for 2 threads:
             .
 */
 
-void DummySearch::build_index(const std::vector<Vector>& dataset) {
+void DummySearch::build_index(const Dataset& dataset) {
     data = dataset;
-    std::cout << "[DummySearch] Index built with " << dataset.size() << " vectors.\n";
+    std::cout << "[DummySearch] Index built with " << dataset.rows() << " vectors.\n";
 }
 
 SearchResult DummySearch::search(const Vector& query, const Params& params, int query_id) const {
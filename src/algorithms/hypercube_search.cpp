@@ -1,16 +1,17 @@
 #include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <functional>
 #include <iostream>
 #include <limits>
 #include <queue>
 #include <random>
 #include <stdexcept>
-#include <unordered_set>
 
 #include "../../include/algorithms/hypercube_search.h"
 #include "../../include/utils/args_parser.h"
 #include "../../include/common/metrics.h"
+#include "../../include/utils/index_io.h"
 
 namespace {
 using Clock = std::chrono::high_resolution_clock;
@@ -23,17 +24,21 @@ void HypercubeSearch::configure(const Args& args) {
         std::cerr << "[Hypercube] capping kproj from " << kproj_ << " to 32\n";
         kproj_ = 32;
     }
+    set_search_params(args);
+    w_ = args.w > 0.0 ? args.w : 600.0;
+}
+
+void HypercubeSearch::set_search_params(const Args& args) {
     max_candidates_ = std::max(0, args.M);
     max_probes_ = std::max(1, args.probes);
-    w_ = args.w > 0.0 ? args.w : 4.0;
 }
 
-void HypercubeSearch::build_index(const std::vector<Vector>& dataset) {
-    dataset_ = dataset;
+void HypercubeSearch::build_index(const Dataset& dataset) {
+    dataset_ = dataset.widened();
     cube_.clear();
     projections_.clear();
     offsets_.clear();
-    space_dim_ = dataset_.empty() ? 0u : static_cast<uint32_t>(dataset_[0].values.size());
+    space_dim_ = dataset_.empty() ? 0u : static_cast<uint32_t>(dataset_.dim());
 
     if (dataset_.empty()) {
         std::cout << "[Hypercube] dataset is empty, index cleared\n";
@@ -63,25 +68,103 @@ void HypercubeSearch::build_index(const std::vector<Vector>& dataset) {
         offsets_[i] = uniform(rng);
     }
 
-    cube_.reserve(dataset_.size());
-    for (size_t idx = 0; idx < dataset_.size(); ++idx) {
-        if (dataset_[idx].values.size() != space_dim_) {
-            throw std::runtime_error("[Hypercube] inconsistent vector dimensionality");
-        }
-        uint32_t bucket = hash_vector(dataset_[idx].values);
+    cube_.reserve(dataset_.rows());
+    for (size_t idx = 0; idx < dataset_.rows(); ++idx) {
+        uint32_t bucket = hash_vector(dataset_[idx]);
         cube_[bucket].push_back(static_cast<int>(idx));
     }
 
-    std::cout << "[Hypercube] built index with " << dataset_.size()
+    std::cout << "[Hypercube] built index with " << dataset_.rows()
               << " points (dim=" << space_dim_ << ")\n";
     if (metrics::GLOBAL_METRIC_CFG.type != metrics::MetricType::L2) {
         std::cerr << "[Hypercube] warning: random projections expect L2 metric\n";
     }
 }
 
+// projections [kproj][dim], offsets, then the occupied vertices in key
+// order with offsets into one id array
+bool HypercubeSearch::save_index(const std::string& path) const {
+    index_io::Writer out(path, name(), dataset_);
+    out.put(seed_);
+    out.put(kproj_);
+    out.put(w_);
+
+    std::vector<double> projections;
+    for (const auto& row : projections_) projections.insert(projections.end(), row.begin(), row.end());
+    out.array(projections);
+    out.array(offsets_);
+
+    std::vector<uint32_t> keys;
+    keys.reserve(cube_.size());
+    for (const auto& entry : cube_) keys.push_back(entry.first);
+    std::sort(keys.begin(), keys.end());
+    std::vector<uint64_t> starts{0};
+    std::vector<int32_t> ids;
+    for (uint32_t key : keys) {
+        const Bucket& bucket = cube_.at(key);
+        ids.insert(ids.end(), bucket.begin(), bucket.end());
+        starts.push_back(ids.size());
+    }
+    out.array(keys);
+    out.array(starts);
+    out.array(ids);
+    out.finish();
+    return true;
+}
+
+bool HypercubeSearch::load_index(const std::string& path, const Dataset& dataset) {
+    index_io::Reader in(path, name(), dataset);
+    in.expect(seed_, "seed");
+    in.expect(kproj_, "kproj");
+    in.expect(w_, "w");
+
+    const uint32_t dim = dataset.empty() ? 0u : static_cast<uint32_t>(dataset.dim());
+    const auto [projections, n_projections] = in.view<double>();
+    const auto [offsets, n_offsets] = in.view<double>();
+    const auto [keys, n_keys] = in.view<uint32_t>();
+    const auto [starts, n_starts] = in.view<uint64_t>();
+    const auto [ids, n_ids] = in.view<int32_t>();
+    const bool built = !dataset.empty();
+    // every point lives in one vertex; keys are saved strictly increasing, so
+    // a repeated key (which would overwrite a bucket) is out of order
+    const uint64_t n_vertices = uint64_t{1} << kproj_;
+    const auto bad_id = [&](int32_t id) { return id < 0 || static_cast<size_t>(id) >= dataset.rows(); };
+    if (n_projections != (built ? static_cast<size_t>(kproj_) * dim : 0) ||
+        n_offsets != (built ? static_cast<size_t>(kproj_) : 0) || n_starts != n_keys + 1 || starts[0] != 0 ||
+        starts[n_keys] != n_ids || n_ids != dataset.rows() || !std::is_sorted(starts, starts + n_starts) ||
+        std::adjacent_find(keys, keys + n_keys, std::greater_equal<uint32_t>()) != keys + n_keys ||
+        (n_keys > 0 && keys[n_keys - 1] >= n_vertices) || std::any_of(ids, ids + n_ids, bad_id))
+        throw std::runtime_error("corrupt Hypercube index");
+
+    dataset_ = dataset.widened();
+    space_dim_ = dim;
+    projections_.assign(n_offsets, std::vector<double>(space_dim_));
+    for (size_t i = 0; i < n_offsets; ++i)
+        std::copy(projections + i * space_dim_, projections + (i + 1) * space_dim_, projections_[i].begin());
+    offsets_.assign(offsets, offsets + n_offsets);
+
+    cube_.clear();
+    cube_.reserve(n_keys);
+    for (size_t b = 0; b < n_keys; ++b) cube_[keys[b]].assign(ids + starts[b], ids + starts[b + 1]);
+
+    std::cout << "[Hypercube] loaded index with " << dataset_.rows() << " points (dim=" << space_dim_
+              << ") from " << path << "\n";
+    return true;
+}
+
 SearchResult HypercubeSearch::search(const Vector& query,
                                      const Params& params,
                                      int query_id) const {
+    return metrics::dispatch(metrics::GLOBAL_METRIC_CFG, [&](const auto& metric) {
+        return search_impl(metric, query, params, query_id);
+    });
+}
+
+template <typename Metric>
+SearchResult HypercubeSearch::search_impl(const Metric& metric,
+                                          const Vector& query,
+                                          const Params& params,
+                                          int query_id) const {
     auto t0 = Clock::now();
     SearchResult res;
     res.query_id = query_id;
@@ -95,47 +178,51 @@ SearchResult HypercubeSearch::search(const Vector& query,
     const size_t candidate_limit =
         max_candidates_ > 0 ? static_cast<size_t>(max_candidates_) : std::numeric_limits<size_t>::max();
 
-    const uint32_t start_bucket = hash_vector(query.values);
+    const std::vector<float> q = to_float(query);
+    const uint32_t start_bucket = hash_vector(q.data());
 
-    std::queue<uint32_t> agenda;
-    std::unordered_set<uint32_t> visited_buckets;
-    agenda.push(start_bucket);
-    visited_buckets.insert(start_bucket);
+    // Breadth-first over vertices by Hamming distance. A vertex that differs
+    // from the start in bit set S only pushes the bits above max(S), so each
+    // vertex is queued exactly once, in the order a visited-set BFS would
+    // give (sets by size, then lexicographic). Each point lives in exactly
+    // one vertex, so candidates never repeat either: no visited sets needed.
+    std::queue<std::pair<uint32_t, int>> agenda; // (vertex, lowest bit it may flip)
+    agenda.emplace(start_bucket, 0);
 
-    std::unordered_set<int> seen_points;
     size_t examined = 0;
     int probes_examined = 0;
     bool stop = false;
 
+    // candidates are ranked on the comparison distance (squared L2)
+    const bool do_range = params.enable_range && params.R > 0.0;
+    const double R_cmp = Metric::to_comparison(params.R);
+
     using Candidate = std::pair<double, int>;
     std::priority_queue<Candidate> best;
     std::vector<std::pair<int, double>> range_hits;
 
     while (!agenda.empty() && probes_examined < max_probes_ && !stop) {
-        uint32_t current = agenda.front();
+        const auto [current, next_bit] = agenda.front();
         agenda.pop();
         ++probes_examined;
 
         auto it = cube_.find(current);
         if (it != cube_.end()) {
             for (int idx : it->second) {
-                if (!seen_points.insert(idx).second) {
-                    continue;
-                }
-
-                double dist = metrics::distance(dataset_[static_cast<size_t>(idx)].values,
-                                                query.values,
-                                                metrics::GLOBAL_METRIC_CFG);
+                ++res.stats.candidates;
+                double dist = metric(dataset_[static_cast<size_t>(idx)], q.data(), space_dim_);
                 ++examined;
 
                 if (neighbours_requested > 0) {
                     best.emplace(dist, idx);
+                    ++res.stats.heap_operations;
                     if (static_cast<int>(best.size()) > neighbours_requested) {
                         best.pop();
+                        ++res.stats.heap_operations;
                     }
                 }
 
-                if (params.enable_range && params.R > 0.0 && dist <= params.R) {
+                if (do_range && dist <= R_cmp) {
                     range_hits.emplace_back(idx, dist);
                 }
 
@@ -147,15 +234,17 @@ SearchResult HypercubeSearch::search(const Vector& query,
         }
 
         if (probes_examined < max_probes_) {
-            for (int bit = 0; bit < kproj_; ++bit) {
-                uint32_t neighbour = current ^ (1u << bit);
-                if (visited_buckets.insert(neighbour).second) {
-                    agenda.push(neighbour);
-                }
+            for (int bit = next_bit; bit < kproj_; ++bit) {
+                agenda.emplace(current ^ (1u << bit), bit + 1);
             }
         }
     }
 
+    res.stats.buckets_probed = static_cast<std::uint64_t>(probes_examined);
+    res.stats.unique_candidates = examined;
+    res.stats.distance_computations = examined;
+    res.stats.bytes_scanned = examined * space_dim_ * sizeof(float);
+
     std::vector<Candidate> ordered;
     ordered.reserve(best.size());
     while (!best.empty()) {
@@ -167,14 +256,14 @@ SearchResult HypercubeSearch::search(const Vector& query,
 
     for (const auto& c : ordered) {
         res.neighbor_ids.push_back(c.second);
-        res.distances.push_back(static_cast<float>(c.first));
+        res.distances.push_back(static_cast<float>(Metric::to_true(c.first)));
     }
 
     std::sort(range_hits.begin(), range_hits.end(),
               [](const auto& a, const auto& b) { return a.second < b.second; });
     for (const auto& hit : range_hits) {
         res.range_neighbor_ids.push_back(hit.first);
-        res.range_distances.push_back(static_cast<float>(hit.second));
+        res.range_distances.push_back(static_cast<float>(Metric::to_true(hit.second)));
     }
 
     auto t1 = Clock::now();
@@ -182,7 +271,7 @@ SearchResult HypercubeSearch::search(const Vector& query,
     return res;
 }
 
-uint32_t HypercubeSearch::hash_vector(const std::vector<double>& vec) const {
+uint32_t HypercubeSearch::hash_vector(const float* vec) const {
     uint32_t code = 0;
     for (int i = 0; i < kproj_; ++i) {
         double dot = 0.0;
@@ -14,6 +14,8 @@
 #include "../../include/utils/args_parser.h"
 #include "../../include/common/metrics.h"
 #include "../../include/common/our_math.h"
+#include "../../include/utils/thread_pool.h"
+#include "../../include/utils/index_io.h"
 
 
 void IVFFlatSearch::configure(const Args& args) {
@@ -22,13 +24,18 @@ void IVFFlatSearch::configure(const Args& args) {
     p.nprobe = args.nprobe;
     p.N = args.N;
     p.R = args.R;
+    p.threads = args.threads;
     rng.seed(p.seed);
 }
 
-void IVFFlatSearch::build_index(const std::vector<Vector>& dataset) {
+void IVFFlatSearch::set_search_params(const Args& args) {
+    p.nprobe = args.nprobe;
+}
+
+void IVFFlatSearch::build_index(const Dataset& dataset) {
     data = dataset;
-    space_dim = dataset.empty() ? 0 : static_cast<int>(dataset.front().values.size());
-    n_points = dataset.empty() ? 0 : static_cast<int>(dataset.size());
+    space_dim = dataset.empty() ? 0 : static_cast<int>(dataset.dim());
+    n_points = static_cast<int>(dataset.rows());
     assert(n_points);
     centroids.clear();
 
@@ -55,33 +62,117 @@ void IVFFlatSearch::build_index(const std::vector<Vector>& dataset) {
     }
 
     assigned_centroid.assign(n_points, 0);
+
+    // 2.Assign to nearest centroid
+    parallel_for(static_cast<size_t>(n_points), p.threads, [&](size_t i, int) {
+        Vector row;
+        load_row(static_cast<int>(i), row);
+        assigned_centroid[i] = nearest_centroid(row);
+    });
+    fill_lists();
+    
+    auto [sil, total_sil] = compute_silhouette_fast();
+    std::cout << "sanity check shilhouete_fast: \n \t score: " << total_sil << std::endl;
+
+    index_built = true;
+    std::cout << "[IVFFlat - placeholder] index built with " << data.rows() << " vectors, k=" << p.kclusters << "\n";
+}
+
+void IVFFlatSearch::fill_lists() {
     IL.clear();
     IL.resize(p.kclusters);
-    
+
+    // 3.Append to Inverted List
+    std::vector<std::vector<int>> members(p.kclusters);
     for (int i = 0; i < n_points; i++) {
-        // 2.Assign to nearest centroid
-        assigned_centroid[i] = nearest_centroid(data[i]);
-        // 3.Append to Inverted List
-        IL[assigned_centroid[i]].push_back({i, data[i]});
+        members[assigned_centroid[i]].push_back(i);
     }
-    
-    auto [sil, total_sil] = compute_silhouette_fast();
-    std::cout << "sanity check shilhouete_fast: \n \t score: " << total_sil << std::endl;
+
+    // 4.Pack every list's vectors into one contiguous block. Lists are
+    // allocated and written by the pool threads, so with -affinity their
+    // pages are first-touched across the NUMA nodes (see utils/numa.h)
+    parallel_for(IL.size(), p.threads, [&](size_t c, int) {
+        InvertedList& list = IL[c];
+        list.ids.assign(members[c].begin(), members[c].end());
+        if (data.is_bytes()) {
+            list.byte_vectors = ByteMatrix(list.ids.size(), space_dim);
+            for (size_t r = 0; r < list.ids.size(); ++r) {
+                const uint8_t* src = data.byte_row(list.ids[r]);
+                std::copy(src, src + space_dim, list.byte_vectors[r]);
+            }
+        } else {
+            list.vectors = FloatMatrix(list.ids.size(), space_dim);
+            for (size_t r = 0; r < list.ids.size(); ++r) {
+                std::copy(data[list.ids[r]], data[list.ids[r]] + space_dim, list.vectors[r]);
+            }
+        }
+    }, 1);
+}
+
+bool IVFFlatSearch::save_index(const std::string& path) const {
+    index_io::Writer out(path, name(), data);
+    out.put(p.seed);
+    out.put(p.kclusters);
+
+    std::vector<double> flat;
+    flat.reserve(centroids.size() * space_dim);
+    for (const auto& c : centroids) flat.insert(flat.end(), c.values.begin(), c.values.end());
+    out.array(flat);
+    out.array(assigned_centroid);
+    out.finish();
+    return true;
+}
+
+bool IVFFlatSearch::load_index(const std::string& path, const Dataset& dataset) {
+    index_io::Reader in(path, name(), dataset);
+    in.expect(p.seed, "seed");
+    in.expect(p.kclusters, "kclusters");
+
+    const int dim = dataset.empty() ? 0 : static_cast<int>(dataset.dim());
+    const auto [flat, n_flat] = in.view<double>();
+    const auto [assigned, n_assigned] = in.view<int>();
+    if (n_flat != static_cast<size_t>(p.kclusters) * dim || n_assigned != dataset.rows() ||
+        std::any_of(assigned, assigned + n_assigned, [&](int c) { return c < 0 || c >= p.kclusters; }))
+        throw std::runtime_error("corrupt IVFFlat index");
+
+    data = dataset;
+    space_dim = dim;
+    n_points = static_cast<int>(dataset.rows());
+    centroids.assign(p.kclusters, Vector{});
+    for (int c = 0; c < p.kclusters; ++c)
+        centroids[c].values.assign(flat + static_cast<size_t>(c) * dim, flat + static_cast<size_t>(c + 1) * dim);
+    assigned_centroid.assign(assigned, assigned + n_assigned);
+    fill_lists();
 
     index_built = true;
-    std::cout << "[IVFFlat - placeholder] index built with " << data.size() << " vectors, k=" << p.kclusters << "\n";
+    std::cout << "[IVFFlat] index loaded with " << data.rows() << " vectors, k=" << p.kclusters << " from " << path
+              << "\n";
+    return true;
 }
 
 SearchResult IVFFlatSearch::search(const Vector& query, const Params& params, int query_id) const {
-    auto t0 = std::chrono::high_resolution_clock::now();
-    SearchResult res; 
-    res.query_id = query_id;
-    
-    if (data.empty() || space_dim == 0 || static_cast<int>(query.values.size()) != space_dim) {
-        res.time_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
-        return res;
-    }
+    return metrics::dispatch(metrics::GLOBAL_METRIC_CFG, [&](const auto& metric) {
+        return search_impl(metric, query, params, query_id);
+    });
+}
+
+std::vector<SearchResult> IVFFlatSearch::search_batch(const Vector* queries, size_t nq, const Params& params) const {
+    return metrics::dispatch(metrics::GLOBAL_METRIC_CFG, [&](const auto& metric) {
+        return search_batch_impl(metric, queries, nq, params);
+    });
+}
+
+IVFFlatSearch::QueryRows IVFFlatSearch::prepare_query(const Vector& query) const {
+    QueryRows qr;
+    qr.q = to_float(query);
+    qr.byte_query = data.is_bytes() && to_bytes(query, qr.qb);
+    return qr;
+}
 
+template <typename Metric>
+std::vector<std::pair<int, double>> IVFFlatSearch::probe_lists(const Metric& metric, const Vector& query,
+                                                               SearchStats& stats) const {
+    // all ranking below uses the comparison distance (squared L2)
     std::vector<std::pair<int, double>> S; // centroid_index, dist
     S.reserve((int)p.kclusters); 
 
@@ -89,11 +180,7 @@ SearchResult IVFFlatSearch::search(const Vector& query, const Params& params, in
     
     // a. Calculate distance to all k centroids
     for (int j = 0; j < (int)p.kclusters; ++j) {
-        double dist = metrics::distance(
-            query.values, 
-            centroids[j].values, 
-            metrics::GLOBAL_METRIC_CFG
-        );
+        double dist = metric(query.values, centroids[j].values);
         S.push_back({j, dist}); 
     }
 
@@ -108,49 +195,89 @@ SearchResult IVFFlatSearch::search(const Vector& query, const Params& params, in
         [](const auto& a, const auto& b) { return a.second < b.second; }
     );
     S.resize(effective_nprobes);
+    stats.distance_computations = p.kclusters;
+    stats.bytes_scanned = (std::uint64_t)p.kclusters * space_dim * sizeof(double);
+    stats.buckets_probed = effective_nprobes;
+    return S;
+}
 
-    // 2. Compute U (b)
-    std::vector<std::pair<int, double>> b; // candidate_index, dist
-    
-    // Iterate through the selected 'nprobes' centroids in S
-    for (const auto& g : S) { // g is {centroid_index, dist_to_q}
-
-        // Iterate through all data points assigned to this centroid (IL[centroid_idx])
-        for (const auto& entry : IL[g.first]) { // entry is {data_index, data[data_index]}
+// distances from the query to rows [r0, r0 + count) of a list
+template <typename Metric>
+void IVFFlatSearch::scan_rows(const Metric& metric, const QueryRows& qr, const InvertedList& list,
+                              size_t r0, size_t count, double* out) const {
+    if (qr.byte_query)
+        metric.many(qr.qb.data(), list.byte_vectors[r0], list.byte_vectors.stride(), count, space_dim, out);
+    else if (data.is_bytes())
+        metric.many(qr.q.data(), list.byte_vectors[r0], list.byte_vectors.stride(), count, space_dim, out);
+    else
+        metric.many(qr.q.data(), list.vectors[r0], list.vectors.stride(), count, space_dim, out);
+}
 
-            // Calculate the distance from query 'q' to the data point 'x'
-            double dist = metrics::distance(
-                    query.values, 
-                    entry.second.values, // Access full dataset using index
-                    metrics::GLOBAL_METRIC_CFG
-                );
-            b.push_back({entry.first, dist});
-        }
-    }
+template <typename Metric>
+void IVFFlatSearch::finish(std::vector<std::pair<int, double>>& b, const Params& params, SearchResult& res) const {
+    // lists are disjoint, every candidate is scored once
+    res.stats.unique_candidates = res.stats.candidates;
+    res.stats.distance_computations += res.stats.candidates;
 
     // 3. Find the R nearest b
 
     if (!b.empty()) {
         
-        std::partial_sort(b.begin(), b.begin() + params.N, b.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+        res.stats.heap_operations = b.size();
+        int topK = select_top_n(b, params.N);
         
-        int topK = std::min(params.N, static_cast<int>(b.size()));
         for (int i = 0; i < topK; ++i) {
             res.neighbor_ids.push_back(b[i].first);
-            res.distances.push_back(static_cast<float>(b[i].second));
+            res.distances.push_back(static_cast<float>(Metric::to_true(b[i].second)));
         }
         
         if (params.enable_range && params.R > 0.0) {
+            const double R_cmp = Metric::to_comparison(params.R);
             for (const auto& cand : b) {
-                if (cand.second <= params.R) {
+                if (cand.second <= R_cmp) {
                     res.range_neighbor_ids.push_back(cand.first);
-                    res.range_distances.push_back(static_cast<float>(cand.second));
+                    res.range_distances.push_back(static_cast<float>(Metric::to_true(cand.second)));
                 } else {
                     break;
                 }
             }
         }
     }
+}
+
+template <typename Metric>
+SearchResult IVFFlatSearch::search_impl(const Metric& metric, const Vector& query, const Params& params, int query_id) const {
+    auto t0 = std::chrono::high_resolution_clock::now();
+    SearchResult res; 
+    res.query_id = query_id;
+    
+    if (data.empty() || space_dim == 0 || static_cast<int>(query.values.size()) != space_dim) {
+        res.time_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+        return res;
+    }
+
+    const std::vector<std::pair<int, double>> S = probe_lists(metric, query, res.stats);
+
+    // 2. Compute U (b)
+    std::vector<std::pair<int, double>> b; // candidate_index, dist
+    const QueryRows qr = prepare_query(query);
+    std::vector<double> list_dist;
+    
+    // Iterate through the selected 'nprobes' centroids in S
+    for (const auto& g : S) { // g is {centroid_index, dist_to_q}
+        const InvertedList& list = IL[g.first];
+        const size_t count = list.ids.size();
+
+        // Stream the whole list block: distances from query 'q' to every x in it
+        list_dist.resize(count);
+        if (count > 0) scan_rows(metric, qr, list, 0, count, list_dist.data());
+        for (size_t r = 0; r < count; ++r) {
+            b.push_back({list.ids[r], list_dist[r]});
+        }
+        res.stats.candidates += count;
+        res.stats.bytes_scanned += count * space_dim * data.elem_size();
+    }
+    finish<Metric>(b, params, res);
 
     auto t1 = std::chrono::high_resolution_clock::now();
     res.time_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
@@ -158,13 +285,88 @@ SearchResult IVFFlatSearch::search(const Vector& query, const Params& params, in
         
 }
 
+// Same results as search() per query. The probed lists of the whole batch are
+// visited once each, a tile of rows at a time, and every query probing the
+// list is scored against the tile while it is in cache. Each query's
+// candidates land at the position search() would give them, so ties break
+// the same way.
+template <typename Metric>
+std::vector<SearchResult> IVFFlatSearch::search_batch_impl(const Metric& metric, const Vector* queries, size_t nq,
+                                                           const Params& params) const {
+    constexpr size_t kListTile = 256; // list rows scored against all queries before moving on
+    auto t0 = std::chrono::high_resolution_clock::now();
+    std::vector<SearchResult> results(nq);
+    std::vector<QueryRows> rows(nq);
+    std::vector<std::vector<std::pair<int, double>>> b(nq);
+    std::vector<bool> valid(nq, false);
+    // per list: (query, offset of the list's candidates in that query's b)
+    std::vector<std::vector<std::pair<size_t, size_t>>> visits(IL.size());
+
+    for (size_t i = 0; i < nq; ++i) {
+        SearchResult& res = results[i];
+        res.query_id = static_cast<int>(i);
+        if (data.empty() || space_dim == 0 || static_cast<int>(queries[i].values.size()) != space_dim) continue;
+        valid[i] = true;
+        rows[i] = prepare_query(queries[i]);
+        size_t offset = 0;
+        for (const auto& g : probe_lists(metric, queries[i], res.stats)) {
+            const size_t count = IL[g.first].ids.size();
+            visits[g.first].push_back({i, offset});
+            offset += count;
+            res.stats.candidates += count;
+            res.stats.bytes_scanned += count * space_dim * data.elem_size();
+        }
+        b[i].resize(offset);
+    }
+
+    std::vector<double> tile_dist(kListTile);
+    for (size_t l = 0; l < IL.size(); ++l) {
+        if (visits[l].empty()) continue;
+        const InvertedList& list = IL[l];
+        const size_t count = list.ids.size();
+        for (size_t r0 = 0; r0 < count; r0 += kListTile) {
+            const size_t nb = std::min(kListTile, count - r0);
+            for (const auto& [qi, offset] : visits[l]) {
+                scan_rows(metric, rows[qi], list, r0, nb, tile_dist.data());
+                auto* out = b[qi].data() + offset + r0;
+                for (size_t r = 0; r < nb; ++r) out[r] = {list.ids[r0 + r], tile_dist[r]};
+            }
+        }
+    }
+
+    for (size_t i = 0; i < nq; ++i)
+        if (valid[i]) finish<Metric>(b[i], params, results[i]);
+
+    // the batch is one unit of work; each query is charged an equal share,
+    // which is not a latency of its own (shared_time)
+    const double per_query_ms =
+        std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count() / std::max<size_t>(1, nq);
+    for (SearchResult& res : results) {
+        res.time_ms = per_query_ms;
+        res.shared_time = true;
+    }
+    return results;
+}
+
+// dataset row i as a double Vector, whatever the stored element type
+void IVFFlatSearch::load_row(int i, Vector& out) const {
+    if (data.is_bytes()) row_to_vector(data.byte_row(i), space_dim, out);
+    else row_to_vector(data[i], space_dim, out);
+}
+
+double IVFFlatSearch::point_distance(int a, int b) const {
+    if (data.is_bytes())
+        return metrics::distance(data.byte_row(a), data.byte_row(b), space_dim, metrics::GLOBAL_METRIC_CFG);
+    return metrics::distance(data[a], data[b], space_dim, metrics::GLOBAL_METRIC_CFG);
+}
+
 int IVFFlatSearch::nearest_centroid(const Vector& vec) {
     double min_dist = std::numeric_limits<double>::max(); 
     int nearest = -1;
     
     // compute the distances to all the centroids
     for (int i = 0; i < (int)p.kclusters; i++) {
-        double dist = metrics::distance(
+        double dist = metrics::comparison_distance(
             vec.values,                  // Input vector's values
             centroids[i].values,      // Centroid i's values
             metrics::GLOBAL_METRIC_CFG
@@ -189,7 +391,7 @@ int IVFFlatSearch::second_nearest_centroid(const Vector& vec) {
 
     // compute the distances to all the centroids
     for (int i = 0; i < (int)p.kclusters; i++) {
-        double dist = metrics::distance(
+        double dist = metrics::comparison_distance(
             vec.values,                  // Input vector's values
             centroids[i].values,      // Centroid i's values
             metrics::GLOBAL_METRIC_CFG
@@ -242,7 +444,9 @@ void IVFFlatSearch::random_subset() {
         selected[index] = true;
 
         // push chosen vector into subset
-        subset_data.push_back(data[index]);
+        Vector v;
+        load_row(static_cast<int>(index), v);
+        subset_data.push_back(std::move(v));
     }
 
 }
@@ -375,13 +579,14 @@ std::pair<std::vector<double>, double> IVFFlatSearch::compute_silhouette_fast()
     std::vector<int> assigned((int)p.kclusters, 0);
     double total_sil = 0;
     
-
+    Vector row;
     for (int i = 0; i < n_points; i++) {
         int nearest = assigned_centroid[i];
+        load_row(i, row);
         
         // a_i: distance to own centroid
         double a_i = metrics::distance(
-            data[i].values, 
+            row.values, 
             centroids[nearest].values, 
             metrics::GLOBAL_METRIC_CFG
         );
@@ -391,7 +596,7 @@ std::pair<std::vector<double>, double> IVFFlatSearch::compute_silhouette_fast()
         for (int c = 0; c < (int)p.kclusters; c++) {
             if (c != nearest) {
                 double dist = metrics::distance(
-                    data[i].values, 
+                    row.values, 
                     centroids[c].values, 
                     metrics::GLOBAL_METRIC_CFG
                 );
@@ -445,6 +650,7 @@ std::pair<std::vector<double>, double> IVFFlatSearch::compute_silhouette() {
     std::vector<int> assigned((int)p.kclusters, 0);
     double total_sil = 0;
     
+    Vector row;
     for (int i = 0; i < n_points; i++) {
 
         int nearest = assigned_centroid[i];
@@ -460,11 +666,7 @@ std::pair<std::vector<double>, double> IVFFlatSearch::compute_silhouette() {
 
             for (const int idx : cluster) {
                 if (idx != i) {
-                    a_i_dists.push_back(metrics::distance(
-                        data[i].values, 
-                        data[idx].values, 
-                        metrics::GLOBAL_METRIC_CFG
-                    ));
+                    a_i_dists.push_back(point_distance(i, idx));
                 }
             }
             a_i = our_math::mean(a_i_dists);
@@ -472,17 +674,14 @@ std::pair<std::vector<double>, double> IVFFlatSearch::compute_silhouette() {
         
         // Compute b_i: mean distance to second nearest cluster
         double b_i = 0;
-        int second_nearest = second_nearest_centroid(data[i]);
+        load_row(i, row);
+        int second_nearest = second_nearest_centroid(row);
         const auto& second_cluster_indices = centroids_map.at((size_t)second_nearest);
         std::vector<double> b_i_dists;
         b_i_dists.reserve(second_cluster_indices.size());
             
         for (const int idx : centroids_map[second_nearest]) {
-            b_i_dists.push_back(metrics::distance(
-                data[i].values, 
-                data[idx].values, 
-                metrics::GLOBAL_METRIC_CFG
-            ));
+            b_i_dists.push_back(point_distance(i, idx));
         }
 
         if (!b_i_dists.empty()) b_i = our_math::mean(b_i_dists);
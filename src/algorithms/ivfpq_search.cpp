@@ -4,12 +4,13 @@
 #include <iostream>
 #include <limits>
 #include <numeric>
-#include <unordered_set>
 
 #include "../../include/algorithms/ivfpq_search.h"
 #include "../../include/utils/args_parser.h"
 #include "../../include/common/metrics.h"
 #include "../../include/common/our_math.h"
+#include "../../include/utils/thread_pool.h"
+#include "../../include/utils/index_io.h"
 
 namespace {
 using Clock = std::chrono::high_resolution_clock;
@@ -68,7 +69,8 @@ std::vector<Vector> kmeans_pp(const std::vector<Vector>& points,
         }
     }
 
-    centers.resize(actual_k);
+    // fewer distinct points than k: pad with copies (empty clusters are re-seeded below)
+    for (size_t i = 0; static_cast<int>(centers.size()) < actual_k; ++i) centers.push_back(centers[i]);
 
     const int max_iters = 20;
     std::vector<int> assignment(points.size(), -1);
@@ -133,12 +135,17 @@ void IVFPQSearch::configure(const Args& args) {
     p.nbits = args.pq_nbits;
     p.N = args.N;
     p.R = args.R;
+    p.threads = args.threads;
     rng.seed(static_cast<std::mt19937::result_type>(p.seed));
 }
 
-void IVFPQSearch::build_index(const std::vector<Vector>& dataset) {
-    data = dataset;
-    n_points_ = static_cast<int>(data.size());
+void IVFPQSearch::set_search_params(const Args& args) {
+    p.nprobe = args.nprobe;
+}
+
+void IVFPQSearch::build_index(const Dataset& dataset) {
+    data = dataset.widened();
+    n_points_ = static_cast<int>(data.rows());
     index_built = false;
 
     if (data.empty()) {
@@ -146,7 +153,7 @@ void IVFPQSearch::build_index(const std::vector<Vector>& dataset) {
         return;
     }
 
-    space_dim_ = static_cast<int>(data.front().values.size());
+    space_dim_ = static_cast<int>(data.dim());
     if (space_dim_ == 0) {
         throw std::runtime_error("[IVFPQ] dataset vectors have zero dimension");
     }
@@ -166,7 +173,8 @@ void IVFPQSearch::build_index(const std::vector<Vector>& dataset) {
     // 1.Lloyd's Clustering
     random_subset();
     if (subset_data.empty()) {
-        subset_data = data;
+        subset_data.resize(data.rows());
+        for (size_t i = 0; i < data.rows(); ++i) row_to_vector(data[i], data.dim(), subset_data[i]);
         subset_assignments_.assign(subset_data.size(), 0);
     }
 
@@ -192,10 +200,12 @@ void IVFPQSearch::build_index(const std::vector<Vector>& dataset) {
 
     // 2. Build Inverted Lists
     data_assignments_.assign(n_points_, -1);
-    for (int i = 0; i < n_points_; ++i) {
+    parallel_for(static_cast<size_t>(n_points_), p.threads, [&](size_t i, int) {
         // 2.Assign to nearest centroid
-        data_assignments_[i] = nearest_centroid(data[static_cast<size_t>(i)]);
-    }
+        Vector row;
+        row_to_vector(data[i], data.dim(), row);
+        data_assignments_[i] = nearest_centroid(row);
+    });
     std::cout << "[IVFPQ] Data assignment to centroids completed.\n";
 
     // Check Silhouette score
@@ -206,46 +216,185 @@ void IVFPQSearch::build_index(const std::vector<Vector>& dataset) {
     std::cout << "[IVFPQ] PQ codebooks built with " << codebook_size_
               << " centroids per sub-vector.\n";
     // 3. Encode points and build inverted lists
-    point_codes_.assign(n_points_, std::vector<std::uint8_t>(p.M, 0));
-    inverted_lists_.assign(static_cast<size_t>(p.kclusters), {});
-    for (int i = 0; i < n_points_; ++i) {
-        int cid = data_assignments_[i];
-        if (cid < 0) continue;
-        point_codes_[static_cast<size_t>(i)] = encode_point(data[static_cast<size_t>(i)], cid);
-        // 3.Append to Inverted List
-        inverted_lists_[static_cast<size_t>(cid)].push_back(i);
-    }
-    std::cout << "[IVFPQ] Inverted lists built with " << inverted_lists_.size() << " clusters.\n";
+    const size_t M = static_cast<size_t>(p.M);
+    std::vector<std::uint8_t> codes(static_cast<size_t>(n_points_) * M, 0);
+    parallel_for(static_cast<size_t>(n_points_), p.threads, [&](size_t i, int) {
+        if (data_assignments_[i] < 0) return;
+        const std::vector<std::uint8_t> code = encode_point(data[i], data_assignments_[i]);
+        std::copy(code.begin(), code.end(), codes.begin() + static_cast<std::ptrdiff_t>(i * M));
+    });
+    fill_lists(codes);
+    std::cout << "[IVFPQ] Inverted lists built with " << n_lists_ << " clusters.\n";
     index_built = true;
-    std::cout << "[IVFPQ] index built with " << data.size()
+    std::cout << "[IVFPQ] index built with " << data.rows()
               << " vectors (dim=" << space_dim_
               << ", k=" << p.kclusters
               << ", M=" << p.M
               << ", codebook=" << codebook_size_ << ")\n";
 }
 
+void IVFPQSearch::fill_lists(const std::vector<std::uint8_t>& codes) {
+    const size_t M = static_cast<size_t>(p.M);
+    auto lists = std::make_shared<ListArrays>();
+    lists->offsets.assign(static_cast<size_t>(p.kclusters) + 1, 0);
+    for (int cid : data_assignments_)
+        if (cid >= 0) ++lists->offsets[static_cast<size_t>(cid) + 1];
+    for (size_t c = 0; c + 1 < lists->offsets.size(); ++c) lists->offsets[c + 1] += lists->offsets[c];
+
+    // 3.Append to Inverted List (in id order, as a serial build would)
+    const size_t n_entries = lists->offsets.back();
+    std::vector<int> order(n_entries);
+    std::vector<std::uint32_t> next(lists->offsets.begin(), lists->offsets.end() - 1);
+    for (int i = 0; i < n_points_; ++i) {
+        const int cid = data_assignments_[static_cast<size_t>(i)];
+        if (cid >= 0) order[next[static_cast<size_t>(cid)]++] = i;
+    }
+
+    // ids and codes are left unwritten and filled list by list on the pool
+    // threads, so each list's pages belong to the node of the thread writing it
+    lists->ids = Matrix<int>(1, n_entries, 1, Matrix<int>::Uninitialized{});
+    lists->codes = Matrix<std::uint8_t>(n_entries, M, 1, Matrix<std::uint8_t>::Uninitialized{});
+    int* ids = lists->ids.data();
+    std::uint8_t* list_codes = lists->codes.data();
+    parallel_for(static_cast<size_t>(p.kclusters), p.threads, [&](size_t c, int) {
+        for (size_t e = lists->offsets[c]; e < lists->offsets[c + 1]; ++e) {
+            ids[e] = order[e];
+            std::copy(codes.begin() + static_cast<std::ptrdiff_t>(order[e] * M),
+                      codes.begin() + static_cast<std::ptrdiff_t>((order[e] + 1) * M), list_codes + e * M);
+        }
+    }, 1);
+
+    list_offsets_ = lists->offsets.data();
+    list_ids_ = ids;
+    list_codes_ = list_codes;
+    n_lists_ = static_cast<size_t>(p.kclusters);
+    lists_owner_ = std::move(lists);
+}
+
+// coarse centroids, the list arrays (offsets, ids, codes) and codebooks
+// [M][codebook][subvector dim]
+bool IVFPQSearch::save_index(const std::string& path) const {
+    index_io::Writer out(path, name(), data);
+    out.put(p.seed);
+    out.put(p.kclusters);
+    out.put(p.M);
+    out.put(p.nbits);
+    out.put(index_built);
+
+    std::vector<double> flat;
+    for (const auto& c : centroids) flat.insert(flat.end(), c.values.begin(), c.values.end());
+    out.array(flat);
+    const std::uint64_t n_entries = n_lists_ > 0 ? list_offsets_[n_lists_] : 0;
+    out.array(list_offsets_, n_lists_ > 0 ? n_lists_ + 1 : 0);
+    out.array(list_ids_, n_entries);
+    out.array(list_codes_, n_entries * static_cast<std::uint64_t>(p.M));
+
+    flat.clear();
+    for (const auto& book : pq_codebooks_)
+        for (const auto& word : book) flat.insert(flat.end(), word.values.begin(), word.values.end());
+    out.array(flat);
+    out.finish();
+    return true;
+}
+
+bool IVFPQSearch::load_index(const std::string& path, const Dataset& dataset) {
+    index_io::Reader in(path, name(), dataset);
+    in.expect(p.seed, "seed");
+    in.expect(p.kclusters, "kclusters");
+    in.expect(p.M, "M");
+    in.expect(p.nbits, "nbits");
+    const bool built = in.get<bool>();
+
+    const auto [coarse, n_coarse] = in.view<double>();
+    const auto [offsets, n_offsets] = in.view<std::uint32_t>();
+    const auto [ids, n_ids] = in.view<int>();
+    const auto [codes, n_codes] = in.view<std::uint8_t>();
+    const auto [words, n_words] = in.view<double>();
+
+    data = dataset.widened();
+    n_points_ = static_cast<int>(data.rows());
+    index_built = false;
+    centroids.clear();
+    data_assignments_.clear();
+    lists_owner_.reset();
+    list_offsets_ = nullptr;
+    list_ids_ = nullptr;
+    list_codes_ = nullptr;
+    n_lists_ = 0;
+    pq_codebooks_.clear();
+    if (!built) {
+        std::cout << "[IVFPQ] loaded an empty index from " << path << "\n";
+        return true;
+    }
+
+    space_dim_ = static_cast<int>(data.dim());
+    subvector_dim_ = space_dim_ / p.M;
+    codebook_size_ = 1 << p.nbits;
+    const size_t dim = static_cast<size_t>(space_dim_), sub = static_cast<size_t>(subvector_dim_);
+    const size_t M = static_cast<size_t>(p.M), K = static_cast<size_t>(codebook_size_);
+    const size_t n_centroids = n_coarse / dim;
+    // lists past the last centroid must be empty
+    if (n_coarse % dim != 0 || n_centroids > static_cast<size_t>(p.kclusters) ||
+        n_offsets != static_cast<size_t>(p.kclusters) + 1 || offsets[0] != 0 ||
+        !std::is_sorted(offsets, offsets + n_offsets) || offsets[n_centroids] != n_ids ||
+        offsets[n_offsets - 1] != n_ids || n_ids > data.rows() ||
+        n_codes != n_ids * M || n_words != M * K * sub ||
+        std::any_of(ids, ids + n_ids, [&](int i) { return i < 0 || i >= n_points_; }) ||
+        std::any_of(codes, codes + n_codes, [&](std::uint8_t c) { return c >= K; })) // LUT rows have K entries
+        throw std::runtime_error("corrupt IVFPQ index");
+
+    centroids.resize(n_centroids);
+    for (size_t c = 0; c < n_centroids; ++c) centroids[c].values.assign(coarse + c * dim, coarse + (c + 1) * dim);
+    // the lists (ids and codes, the bulk of the index) stay in the mapping;
+    // centroids and codebooks are small and go back into their build-time form
+    lists_owner_ = in.mapping();
+    list_offsets_ = offsets;
+    list_ids_ = ids;
+    list_codes_ = codes;
+    n_lists_ = n_offsets - 1;
+    pq_codebooks_.assign(M, std::vector<Vector>(K));
+    for (size_t m = 0; m < M; ++m)
+        for (size_t h = 0; h < K; ++h) {
+            const double* word = words + (m * K + h) * sub;
+            pq_codebooks_[m][h].values.assign(word, word + sub);
+        }
+
+    index_built = true;
+    std::cout << "[IVFPQ] index loaded with " << data.rows() << " vectors (dim=" << space_dim_
+              << ", k=" << p.kclusters << ", M=" << p.M << ", codebook=" << codebook_size_ << ") from " << path
+              << "\n";
+    return true;
+}
+
 SearchResult IVFPQSearch::search(const Vector& query, const Params& params, int query_id) const {
-    auto t0 = Clock::now();
-    SearchResult res;
-    res.query_id = query_id;
+    return metrics::dispatch(metrics::GLOBAL_METRIC_CFG, [&](const auto& metric) {
+        return search_impl(metric, query, params, query_id);
+    });
+}
 
-    if (!index_built || data.empty() || centroids.empty()) {
-        res.time_ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
-        return res;
-    }
-    if (static_cast<int>(query.values.size()) != space_dim_) {
-        res.time_ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
-        return res;
-    }
+std::vector<SearchResult> IVFPQSearch::search_batch(const Vector* queries, size_t nq, const Params& params) const {
+    return metrics::dispatch(metrics::GLOBAL_METRIC_CFG, [&](const auto& metric) {
+        return search_batch_impl(metric, queries, nq, params);
+    });
+}
+
+bool IVFPQSearch::searchable(const Vector& query) const {
+    return index_built && !data.empty() && !centroids.empty() && static_cast<int>(query.values.size()) == space_dim_;
+}
 
+template <typename Metric>
+std::vector<std::pair<int, double>> IVFPQSearch::probe_lists(const Metric& metric, const Vector& query,
+                                                             SearchStats& stats) const {
     // 1. Distance to all centroids & select top 'nprobes'
     // a. Calculate distance to all k centroids
     std::vector<std::pair<int, double>> coarse;
     coarse.reserve(static_cast<size_t>(p.kclusters));
     for (int j = 0; j < static_cast<int>(centroids.size()); ++j) {
-        double dist = metrics::distance(query.values, centroids[static_cast<size_t>(j)].values, metrics::GLOBAL_METRIC_CFG);
+        double dist = metric(query.values, centroids[static_cast<size_t>(j)].values);
         coarse.emplace_back(j, dist);
     }
+    stats.distance_computations = centroids.size();
+    stats.bytes_scanned = centroids.size() * static_cast<std::uint64_t>(space_dim_) * sizeof(double);
 
     // b. Select the top 'nprobes' closest centroids
     size_t effective_nprobe = std::min(static_cast<size_t>(p.nprobe), coarse.size());
@@ -267,102 +416,158 @@ SearchResult IVFPQSearch::search(const Vector& query, const Params& params, int
             [](const auto& a, const auto& b) { return a.second < b.second; }
         );
     }
+    stats.lut_builds = coarse.size();
+    stats.buckets_probed = coarse.size();
+    for (const auto& entry : coarse) stats.candidates += list_size(static_cast<size_t>(entry.first));
+    // lists are disjoint and every point has M codes: each entry is one ADC candidate
+    stats.unique_candidates = stats.adc_evaluations = stats.candidates;
+    stats.bytes_scanned += stats.candidates * static_cast<std::uint64_t>(p.M);
+    return coarse;
+}
 
-    // 2. Compute compute residual and LUT values for PQ
-    struct Candidate { int idx; double dist; };
-    std::vector<Candidate> candidates;
-    candidates.reserve(256);
-
-    std::unordered_set<int> visited;
-
-    std::vector<std::vector<double>> lut(static_cast<size_t>(p.M), std::vector<double>(static_cast<size_t>(codebook_size_), 0.0));
-
-    // Iterate through the selected 'nprobes' centroids in S
-    for (const auto& entry : coarse) {
-        int cid = entry.first;
-        if (cid < 0 || cid >= static_cast<int>(centroids.size())) continue;
-
-        std::vector<double> residual(space_dim_);
-        const auto& centroid = centroids[static_cast<size_t>(cid)].values;
-        for (int d = 0; d < space_dim_; ++d) {
-            residual[static_cast<size_t>(d)] = query.values[static_cast<size_t>(d)] - centroid[static_cast<size_t>(d)];
-        }
-
-        for (int m = 0; m < p.M; ++m) {
-            size_t offset = static_cast<size_t>(m * subvector_dim_);
-            for (int h = 0; h < codebook_size_; ++h) {
-                const auto& code_centroid = pq_codebooks_[static_cast<size_t>(m)][static_cast<size_t>(h)].values;
-                double accum = 0.0;
-                for (int d = 0; d < subvector_dim_; ++d) {
-                    double diff = residual[offset + static_cast<size_t>(d)] - code_centroid[static_cast<size_t>(d)];
-                    accum += diff * diff;
-                }
-                lut[static_cast<size_t>(m)][static_cast<size_t>(h)] = accum;
-            }
-        }
-
-        for (int idx : inverted_lists_[static_cast<size_t>(cid)]) {
-            if (!visited.insert(idx).second) continue;
-
-            const auto& codes = point_codes_[static_cast<size_t>(idx)];
-            if (static_cast<int>(codes.size()) != p.M) continue;
-
-            // Step 3: accumulate ADC distance
-            double dist_sq = 0.0;
-            for (int m = 0; m < p.M; ++m) {
-                std::size_t code = static_cast<std::size_t>(codes[static_cast<size_t>(m)]);
-                dist_sq += lut[static_cast<size_t>(m)][code];
-            }
-            double dist = std::sqrt(dist_sq);
-            candidates.push_back({idx, dist});
-        }
+// Step 3: ADC distance of every point of list `cid` under its LUT
+void IVFPQSearch::scan_list(int cid, const std::vector<std::vector<double>>& lut, Candidate* out) const {
+    const size_t M = static_cast<size_t>(p.M);
+    const size_t begin = list_offsets_[static_cast<size_t>(cid)], end = list_offsets_[static_cast<size_t>(cid) + 1];
+    const std::uint8_t* codes = list_codes_ + begin * M;
+    for (size_t e = begin; e < end; ++e, codes += M) {
+        double dist_sq = 0.0;
+        for (size_t m = 0; m < M; ++m) dist_sq += lut[m][codes[m]];
+        out[e - begin] = {list_ids_[e], dist_sq};
     }
+}
 
+template <typename Metric>
+void IVFPQSearch::finish(const Metric& metric, const Vector& query, std::vector<Candidate>& candidates,
+                         const Params& params, SearchResult& res) const {
+    bool exact_fallback = false;
     if (candidates.empty()) {
-        for (size_t i = 0; i < data.size(); ++i) {
-            double dist = metrics::distance(query.values, data[i].values, metrics::GLOBAL_METRIC_CFG);
+        exact_fallback = true;
+        const std::vector<float> q = to_float(query);
+        for (size_t i = 0; i < data.rows(); ++i) {
+            double dist = metric(q.data(), data[i], data.dim());
             candidates.push_back({static_cast<int>(i), dist});
         }
+        res.stats.distance_computations += data.rows();
+        res.stats.bytes_scanned += data.rows() * data.dim() * sizeof(float);
     }
+    // ADC distances are squared L2 whatever the metric; the fallback uses the metric
+    auto true_distance = [&](double d) {
+        return exact_fallback ? Metric::to_true(d) : std::sqrt(d);
+    };
 
     // 3. Find the R nearest b
+    res.stats.heap_operations = candidates.size();
     std::sort(candidates.begin(), candidates.end(),
               [](const Candidate& a, const Candidate& b) { return a.dist < b.dist; });
 
     int topK = std::min(params.N, static_cast<int>(candidates.size()));
     for (int i = 0; i < topK; ++i) {
         res.neighbor_ids.push_back(candidates[static_cast<size_t>(i)].idx);
-        res.distances.push_back(static_cast<float>(candidates[static_cast<size_t>(i)].dist));
+        res.distances.push_back(static_cast<float>(true_distance(candidates[static_cast<size_t>(i)].dist)));
     }
 
     if (params.enable_range && params.R > 0.0) {
+        const double R_cmp = exact_fallback ? Metric::to_comparison(params.R) : params.R * params.R;
         for (const auto& cand : candidates) {
-            if (cand.dist <= params.R) {
+            if (cand.dist <= R_cmp) {
                 res.range_neighbor_ids.push_back(cand.idx);
-                res.range_distances.push_back(static_cast<float>(cand.dist));
+                res.range_distances.push_back(static_cast<float>(true_distance(cand.dist)));
             } else {
                 break;
             }
         }
     }
+}
+
+template <typename Metric>
+SearchResult IVFPQSearch::search_impl(const Metric& metric, const Vector& query, const Params& params, int query_id) const {
+    auto t0 = Clock::now();
+    SearchResult res;
+    res.query_id = query_id;
+
+    if (!searchable(query)) {
+        res.time_ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        return res;
+    }
+
+    const std::vector<std::pair<int, double>> coarse = probe_lists(metric, query, res.stats);
+
+    // 2. Compute compute residual and LUT values for PQ
+    // ADC candidates keep their squared distance; sqrt is taken only for reported hits
+    std::vector<Candidate> candidates(static_cast<size_t>(res.stats.candidates));
+    std::vector<std::vector<double>> lut(static_cast<size_t>(p.M), std::vector<double>(static_cast<size_t>(codebook_size_), 0.0));
+
+    // Iterate through the selected 'nprobes' centroids in S
+    size_t offset = 0;
+    for (const auto& entry : coarse) {
+        compute_lut(query, entry.first, lut);
+        scan_list(entry.first, lut, candidates.data() + offset);
+        offset += list_size(static_cast<size_t>(entry.first));
+    }
+    finish(metric, query, candidates, params, res);
+
     auto t1 = Clock::now();
     res.time_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
     return res;
 }
 
+// Same results as search() per query. The batch's probes are grouped by list
+// and each list is scanned for all of its queries back to back, so its codes
+// come from memory once and from cache for the other queries. Candidates
+// keep the positions search() gives them, so ties break the same way.
+template <typename Metric>
+std::vector<SearchResult> IVFPQSearch::search_batch_impl(const Metric& metric, const Vector* queries, size_t nq,
+                                                         const Params& params) const {
+    auto t0 = Clock::now();
+    std::vector<SearchResult> results(nq);
+    std::vector<std::vector<Candidate>> candidates(nq);
+    std::vector<bool> valid(nq, false);
+    // per list: (query, offset of the list's candidates in that query's candidates)
+    std::vector<std::vector<std::pair<size_t, size_t>>> visits(n_lists_);
+
+    for (size_t i = 0; i < nq; ++i) {
+        results[i].query_id = static_cast<int>(i);
+        if (!searchable(queries[i])) continue;
+        valid[i] = true;
+        size_t offset = 0;
+        for (const auto& entry : probe_lists(metric, queries[i], results[i].stats)) {
+            visits[static_cast<size_t>(entry.first)].push_back({i, offset});
+            offset += list_size(static_cast<size_t>(entry.first));
+        }
+        candidates[i].resize(offset);
+    }
+
+    std::vector<std::vector<double>> lut(static_cast<size_t>(p.M), std::vector<double>(static_cast<size_t>(codebook_size_), 0.0));
+    for (size_t cid = 0; cid < visits.size(); ++cid) {
+        for (const auto& [qi, offset] : visits[cid]) {
+            compute_lut(queries[qi], static_cast<int>(cid), lut);
+            scan_list(static_cast<int>(cid), lut, candidates[qi].data() + offset);
+        }
+    }
+
+    for (size_t i = 0; i < nq; ++i)
+        if (valid[i]) finish(metric, queries[i], candidates[i], params, results[i]);
+
+    // the batch is one unit of work; each query is charged an equal share,
+    // which is not a latency of its own (shared_time)
+    const double per_query_ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count() / std::max<size_t>(1, nq);
+    for (SearchResult& res : results) {
+        res.time_ms = per_query_ms;
+        res.shared_time = true;
+    }
+    return results;
+}
+
 // Utility: centroid accessors -------------------------------------------------
 
 std::vector<std::vector<int>> IVFPQSearch::get_centroids_map() const {
     const size_t centroid_count = centroids.size();
     std::vector<std::vector<int>> map(centroid_count);
-    // we want to keep a map containing the true values of the vectors, in order to find the median
-    // insert the vectors in the map
-    for (int i = 0; i < n_points_; ++i) {
-        int cid = (i < static_cast<int>(data_assignments_.size())) ? data_assignments_[i] : -1;
-        if (cid >= 0 && cid < static_cast<int>(centroid_count)) {
-            map[static_cast<size_t>(cid)].push_back(i);
-        }
-    }
+    // the ids of every inverted list (also available after load_index, which
+    // does not restore data_assignments_)
+    for (size_t cid = 0; cid < std::min(centroid_count, n_lists_); ++cid)
+        map[cid].assign(list_ids_ + list_offsets_[cid], list_ids_ + list_offsets_[cid + 1]);
     return map;
 }
 
@@ -377,12 +582,14 @@ std::pair<std::vector<double>, double> IVFPQSearch::compute_silhouette_fast() co
     std::vector<int> assigned(centroid_count, 0);
     double total_sil = 0.0;
 
+    Vector row;
     for (int i = 0; i < n_points_; ++i) {
         int nearest = (i < static_cast<int>(data_assignments_.size())) ? data_assignments_[i] : -1;
         if (nearest < 0 || nearest >= static_cast<int>(centroid_count)) continue;
+        row_to_vector(data[static_cast<size_t>(i)], data.dim(), row);
 
         // a_i: distance to own centroid
-        double a_i = metrics::distance(data[static_cast<size_t>(i)].values,
+        double a_i = metrics::distance(row.values,
                                        centroids[static_cast<size_t>(nearest)].values,
                                        metrics::GLOBAL_METRIC_CFG);
 
@@ -390,7 +597,7 @@ std::pair<std::vector<double>, double> IVFPQSearch::compute_silhouette_fast() co
         double b_i = std::numeric_limits<double>::max();
         for (size_t c = 0; c < centroid_count; ++c) {
             if (static_cast<int>(c) == nearest) continue;
-            double dist = metrics::distance(data[static_cast<size_t>(i)].values,
+            double dist = metrics::distance(row.values,
                                             centroids[static_cast<size_t>(c)].values,
                                             metrics::GLOBAL_METRIC_CFG);
             if (dist < b_i) {
@@ -430,6 +637,7 @@ std::pair<std::vector<double>, double> IVFPQSearch::compute_silhouette() const {
     std::vector<int> assigned(centroid_count, 0);
     double total_sil = 0.0;
 
+    Vector row;
     for (int i = 0; i < n_points_; ++i) {
         int nearest = (i < static_cast<int>(data_assignments_.size())) ? data_assignments_[i] : -1;
         if (nearest < 0) continue;
@@ -444,8 +652,9 @@ std::pair<std::vector<double>, double> IVFPQSearch::compute_silhouette() const {
             intra.reserve(cluster_indices.size() - 1);
             for (int idx : cluster_indices) {
                 if (idx != i) {
-                    intra.push_back(metrics::distance(data[static_cast<size_t>(i)].values,
-                                                       data[static_cast<size_t>(idx)].values,
+                    intra.push_back(metrics::distance(data[static_cast<size_t>(i)],
+                                                       data[static_cast<size_t>(idx)],
+                                                       data.dim(),
                                                        metrics::GLOBAL_METRIC_CFG));
                 }
             }
@@ -454,15 +663,17 @@ std::pair<std::vector<double>, double> IVFPQSearch::compute_silhouette() const {
 
         // Compute b_i: mean distance to second nearest cluster
         double b_i = std::numeric_limits<double>::max();
-        int second = second_nearest_centroid(data[static_cast<size_t>(i)]);
+        row_to_vector(data[static_cast<size_t>(i)], data.dim(), row);
+        int second = second_nearest_centroid(row);
         if (second >= 0 && second < static_cast<int>(centroid_count)) {
             const auto& other_indices = centroids_map[static_cast<size_t>(second)];
             if (!other_indices.empty()) {
                 std::vector<double> inter;
                 inter.reserve(other_indices.size());
                 for (int idx : other_indices) {
-                    inter.push_back(metrics::distance(data[static_cast<size_t>(i)].values,
-                                                      data[static_cast<size_t>(idx)].values,
+                    inter.push_back(metrics::distance(data[static_cast<size_t>(i)],
+                                                      data[static_cast<size_t>(idx)],
+                                                      data.dim(),
                                                       metrics::GLOBAL_METRIC_CFG));
                 }
                 if (!inter.empty()) b_i = our_math::mean(inter);
@@ -523,7 +734,9 @@ void IVFPQSearch::random_subset() {
         selected[index] = true;
 
         // push chosen vector into subset
-        subset_data.push_back(data[index]);
+        Vector v;
+        row_to_vector(data[index], data.dim(), v);
+        subset_data.push_back(std::move(v));
     }
     subset_assignments_.assign(subset_data.size(), 0);
 }
@@ -657,7 +870,7 @@ int IVFPQSearch::nearest_centroid(const Vector& vec) const {
     
     // compute the distances to all the centroids
     for (int i = 0; i < static_cast<int>(centroids.size()); ++i) {
-        double dist = metrics::distance(
+        double dist = metrics::comparison_distance(
             vec.values,
             centroids[static_cast<size_t>(i)].values,
             metrics::GLOBAL_METRIC_CFG
@@ -680,7 +893,7 @@ int IVFPQSearch::second_nearest_centroid(const Vector& vec) const {
 
     // compute the distances to all the centroids
     for (int i = 0; i < static_cast<int>(centroids.size()); ++i) {
-        double dist = metrics::distance(
+        double dist = metrics::comparison_distance(
             vec.values,
             centroids[static_cast<size_t>(i)].values,
             metrics::GLOBAL_METRIC_CFG
@@ -699,13 +912,13 @@ int IVFPQSearch::second_nearest_centroid(const Vector& vec) const {
 // PQ helpers -----------------------------------------------------------------
 
 // Step 3: compute residual r(x) = x - c(x)
-std::vector<double> IVFPQSearch::compute_residual(const Vector& vec, int centroid_idx) const {
+std::vector<double> IVFPQSearch::compute_residual(const float* vec, int centroid_idx) const {
     std::vector<double> residual(space_dim_, 0.0);
     if (centroid_idx < 0 || centroid_idx >= static_cast<int>(centroids.size())) return residual;
 
     const auto& centroid = centroids[static_cast<size_t>(centroid_idx)].values;
     for (int d = 0; d < space_dim_; ++d) {
-        residual[static_cast<size_t>(d)] = vec.values[static_cast<size_t>(d)] - centroid[static_cast<size_t>(d)];
+        residual[static_cast<size_t>(d)] = vec[static_cast<size_t>(d)] - centroid[static_cast<size_t>(d)];
     }
     return residual;
 }
@@ -739,8 +952,30 @@ void IVFPQSearch::build_pq_codebooks() {
     }
 }
 
+// ADC table of a query for one coarse cell
+void IVFPQSearch::compute_lut(const Vector& query, int centroid_idx, std::vector<std::vector<double>>& lut) const {
+    std::vector<double> residual(space_dim_);
+    const auto& centroid = centroids[static_cast<size_t>(centroid_idx)].values;
+    for (int d = 0; d < space_dim_; ++d) {
+        residual[static_cast<size_t>(d)] = query.values[static_cast<size_t>(d)] - centroid[static_cast<size_t>(d)];
+    }
+
+    for (int m = 0; m < p.M; ++m) {
+        size_t offset = static_cast<size_t>(m * subvector_dim_);
+        for (int h = 0; h < codebook_size_; ++h) {
+            const auto& code_centroid = pq_codebooks_[static_cast<size_t>(m)][static_cast<size_t>(h)].values;
+            double accum = 0.0;
+            for (int d = 0; d < subvector_dim_; ++d) {
+                double diff = residual[offset + static_cast<size_t>(d)] - code_centroid[static_cast<size_t>(d)];
+                accum += diff * diff;
+            }
+            lut[static_cast<size_t>(m)][static_cast<size_t>(h)] = accum;
+        }
+    }
+}
+
 // Steps 6-7: encode PQ(x) = [code1,...,codeM] for the assigned centroid
-std::vector<std::uint8_t> IVFPQSearch::encode_point(const Vector& vec, int centroid_idx) const {
+std::vector<std::uint8_t> IVFPQSearch::encode_point(const float* vec, int centroid_idx) const {
     std::vector<std::uint8_t> codes(static_cast<size_t>(p.M), 0);
     if (centroid_idx < 0) return codes;
     std::vector<double> residual = compute_residual(vec, centroid_idx);
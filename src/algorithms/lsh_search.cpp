@@ -1,5 +1,4 @@
 #include <iostream>
-#include <unordered_set>
 #include <cmath>
 #include <limits>
 #include <algorithm>
@@ -8,6 +7,9 @@
 
 #include "../../include/algorithms/lsh_search.h"
 #include "../../include/utils/args_parser.h"
+#include "../../include/utils/index_io.h"
+#include "../../include/utils/thread_pool.h"
+#include "../../include/common/visited_set.h"
 
 void LSHSearch::configure(const Args& args) {
     p.seed = args.seed;
@@ -16,161 +18,354 @@ void LSHSearch::configure(const Args& args) {
     p.w = args.w;
     p.N = args.N;
     p.R = args.R;
+    p.table_size = std::max(0, args.table_size);
+    p.T = std::max(0, args.T);
+    p.threads = args.threads;
     rng.seed(args.seed);
 }
 
-void LSHSearch::build_index(const std::vector<Vector>& dataset) {
-    data = dataset;
-    space_dim = dataset.empty() ? 0 : static_cast<int>(dataset.front().values.size());
-    n_points = dataset.empty() ? 0 : static_cast<int>(dataset.size());
+void LSHSearch::set_search_params(const Args& args) {
+    p.T = std::max(0, args.T);
+}
+
+void LSHSearch::build_index(const Dataset& dataset) {
+    data = dataset.widened();
+    space_dim = dataset.empty() ? 0 : static_cast<int>(dataset.dim());
+    n_points = static_cast<int>(dataset.rows());
+    set_table_size();
 
     build_hashes();
-    initialize();
     build_tables();
 
-    std::cout << "[LSH] Built " << p.L << " hash tables for " 
-              << dataset.size() << " vectors (space_dim=" 
+    std::cout << "[LSH] Built " << p.L << " hash tables of " << p.M << " buckets for "
+              << dataset.rows() << " vectors (space_dim=" 
               << space_dim << ")\n";
 }
 
-void LSHSearch::build_hashes() {
-    std::uniform_real_distribution<double> distribution(0.0, p.w);
-
-    for (int i = 0; i < p.L; i++) {
-        std::vector<std::vector<std::pair<int, double>>> hlist;
-        for (int j = 0; j < p.k; j++) {
-            std::vector<std::pair<int, double>> const_values(space_dim);
-            // s, const_m_values
-            for (int l = 0; l < space_dim; l++) {
-                const_values[l].first = distribution(rng);
-                const_values[l].second = modular_power(p.m, l, p.M);
-            }
-            hlist.push_back(const_values);
-        }
-        amplified_hash_fns.push_back(hlist);
+// projection panels, shifts and key multipliers, then every table's CSR arrays
+bool LSHSearch::save_index(const std::string& path) const {
+    index_io::Writer out(path, name(), data);
+    out.put(p.seed);
+    out.put(p.k);
+    out.put(p.L);
+    out.put(p.w);
+    out.put(p.table_size);
+    out.put(table_bits);
+
+    out.array(proj_panels.data(), proj_panels.size());
+    out.array(shifts);
+    out.array(key_mult);
+    for (const auto& table : lsh_tables) {
+        out.array(table.offsets);
+        out.array(table.ids);
+        out.array(table.keys);
     }
+    out.finish();
+    return true;
 }
 
-void LSHSearch::initialize() {
-    lsh_tables.clear();
-    lsh_tables.reserve(p.L);
+bool LSHSearch::load_index(const std::string& path, const Dataset& dataset) {
+    index_io::Reader in(path, name(), dataset);
+    in.expect(p.seed, "seed");
+    in.expect(p.k, "k");
+    in.expect(p.L, "L");
+    in.expect(p.w, "w");
+    in.expect(p.table_size, "table size");
+    const int bits = in.get<int>();
+    if (bits < 0 || bits > 31) throw std::runtime_error("corrupt LSH index");
+    const uint32_t buckets = 1u << bits;
 
-    // initialize all of our hash tables
-    for (int i = 0; i < p.L; i++) {
-        // for each hash table
-        std::vector<std::list<int>> current_hash(p.M);
-        lsh_tables.push_back(std::move(current_hash));
+    const int dim = dataset.empty() ? 0 : static_cast<int>(dataset.dim());
+    const size_t n_panels = (static_cast<size_t>(n_hashes()) + metrics::kDotPanel - 1) / metrics::kDotPanel;
+    FloatMatrix panels(n_panels, dim * metrics::kDotPanel);
+    const auto [proj, n_proj] = in.view<float>();
+    std::vector<float> b = in.array<float>();
+    std::vector<uint64_t> r = in.array<uint64_t>();
+    if (n_proj != panels.size() || b.size() != static_cast<size_t>(n_hashes()) || r.size() != b.size())
+        throw std::runtime_error("corrupt LSH index");
+    std::copy(proj, proj + n_proj, panels.data());
+
+    // views in file order, then copied one table per pool thread (first-touch, as in build_tables)
+    struct TableView {
+        std::pair<const uint32_t*, uint64_t> offsets;
+        std::pair<const int*, uint64_t> ids;
+        std::pair<const uint64_t*, uint64_t> keys;
+    };
+    std::vector<TableView> views(p.L);
+    for (auto& v : views) {
+        v.offsets = in.view<uint32_t>();
+        v.ids = in.view<int>();
+        v.keys = in.view<uint64_t>();
+        const auto [offsets, n_offsets] = v.offsets;
+        const auto [ids, n_ids] = v.ids;
+        const auto bad_id = [&](int id) { return id < 0 || id >= static_cast<int>(dataset.rows()); };
+        if (n_offsets != buckets + 1 || offsets[0] != 0 || offsets[buckets] != n_ids || n_ids != dataset.rows() ||
+            v.keys.second != n_ids || !std::is_sorted(offsets, offsets + n_offsets) ||
+            std::any_of(ids, ids + n_ids, bad_id))
+            throw std::runtime_error("corrupt LSH index");
     }
+    std::vector<LSHTable> tables(p.L);
+    parallel_for(tables.size(), p.threads, [&](size_t t, int) {
+        const TableView& v = views[t];
+        tables[t].offsets.assign(v.offsets.first, v.offsets.first + v.offsets.second);
+        tables[t].ids.assign(v.ids.first, v.ids.first + v.ids.second);
+        tables[t].keys.assign(v.keys.first, v.keys.first + v.keys.second);
+    }, 1);
+
+    data = dataset.widened();
+    space_dim = dim;
+    n_points = static_cast<int>(dataset.rows());
+    table_bits = bits;
+    p.M = buckets;
+    proj_panels = std::move(panels);
+    shifts = std::move(b);
+    key_mult = std::move(r);
+    lsh_tables = std::move(tables);
+
+    std::cout << "[LSH] Loaded " << p.L << " hash tables of " << p.M << " buckets for " << n_points << " vectors from " << path << "\n";
+    return true;
 }
 
-void LSHSearch::build_tables() {
-    for (size_t table_idx = 0; table_idx < amplified_hash_fns.size(); ++table_idx) {
-        const auto& amplified_fn = amplified_hash_fns[table_idx];
-        for (int i = 0; i < n_points; ++i) {
-            int bucket = assign_to_bucket(amplified_fn, data[i]);
-            lsh_tables[table_idx][bucket].push_back(i);
-        }
+void LSHSearch::build_hashes() {
+    std::normal_distribution<double> gaussian(0.0, 1.0);
+    std::uniform_real_distribution<double> uniform(0.0, p.w);
+    std::uniform_int_distribution<uint64_t> multiplier;
+
+    const size_t n = static_cast<size_t>(n_hashes()), dim = static_cast<size_t>(space_dim);
+    FloatMatrix a(n, dim);
+    shifts.resize(n);
+    key_mult.resize(n);
+    for (size_t j = 0; j < n; ++j) {
+        for (size_t d = 0; d < dim; ++d) a[j][d] = static_cast<float>(gaussian(rng));
+        shifts[j] = static_cast<float>(uniform(rng));
+        key_mult[j] = multiplier(rng) | 1;
     }
-}
 
-int LSHSearch::modulo(int a, int b) const {
-    int c = a % b;
-    return (c < 0) ? c + b : c;
+    const size_t n_panels = (n + metrics::kDotPanel - 1) / metrics::kDotPanel;
+    proj_panels = FloatMatrix(n_panels, dim * metrics::kDotPanel);
+    for (size_t pnl = 0; pnl < n_panels; ++pnl) {
+        const size_t first = pnl * metrics::kDotPanel;
+        metrics::pack_dot_panel(a[first], a.stride(), std::min(metrics::kDotPanel, n - first), dim, proj_panels[pnl]);
+    }
 }
 
-// executes the operation (x^y) mod p
-int LSHSearch::modular_power(int x, int y, int p) {
-    int res = 1;
-    x = x % p;
-
-    while (y > 0) {
-        if (y & 1)
-            res = (res * x) % p;
-        y = y >> 1;
-        x = (x * x) % p;
+void LSHSearch::hash_points(const float* xs, size_t stride, size_t nx, int* h, double* frac) const {
+    const metrics::DotPanelKernel dot_panel = metrics::dot_panel_kernel();
+    const metrics::DotPanelVecKernel dot_panel_vec = metrics::dot_panel_vec_kernel();
+    const size_t n = static_cast<size_t>(n_hashes());
+    // a query (nx = 1) is a matrix-vector product: its own kernel, no heap buffer
+    float one[metrics::kDotPanel];
+    std::vector<float> many(nx > 1 ? nx * metrics::kDotPanel : 0);
+    float* dots = nx > 1 ? many.data() : one;
+    for (size_t pnl = 0; pnl < proj_panels.rows(); ++pnl) {
+        if (nx == 1) dot_panel_vec(proj_panels[pnl], xs, space_dim, dots);
+        else dot_panel(proj_panels[pnl], xs, stride, nx, space_dim, dots);
+        const size_t first = pnl * metrics::kDotPanel, count = std::min(metrics::kDotPanel, n - first);
+        for (size_t i = 0; i < nx; ++i)
+            for (size_t t = 0; t < count; ++t) {
+                const double f = (dots[i * metrics::kDotPanel + t] + shifts[first + t]) / p.w;
+                const double cell = std::floor(f);
+                h[i * n + first + t] = static_cast<int>(cell);
+                if (frac) frac[i * n + first + t] = f - cell;
+            }
     }
-    return res;
 }
 
-int LSHSearch::assign_to_bucket(
-    const std::vector<std::vector<std::pair<int, double>>>& amplified_fn,
-    const Vector& x) 
-const {
-    int result = 0;
+// Query-directed probing (Lv et al., multi-probe LSH). Moving coordinate i
+// of g by -1 / +1 costs the distance to that slot boundary, frac[i] /
+// 1 - frac[i] (in units of w); a perturbation scores the sum of squared
+// costs. The 2k single moves are sorted by cost (the cheapest 64 kept) and
+// sets of them are enumerated in score order from a heap (shift: replace
+// the last move by the next one, expand: append the next one). Sets moving
+// one coordinate both ways are skipped.
+void LSHSearch::probe_sequence(const double* frac, int T, ProbeSets& out) const {
+    using Set = ProbeSets::Set;
+    auto& moves = out.moves;
+    moves.clear();
+    for (int i = 0; i < p.k; ++i) {
+        moves.push_back({frac[i] * frac[i], i, -1});
+        moves.push_back({(1.0 - frac[i]) * (1.0 - frac[i]), i, +1});
+    }
+    std::sort(moves.begin(), moves.end(), [](const auto& a, const auto& b) { return a.cost < b.cost; });
+    if (moves.size() > 64) moves.resize(64);
 
-    for (auto& hash_it : amplified_fn) {
-        uint32_t h = 0;
-        std::vector<int> a(space_dim, 0);
+    out.sets.clear();
+    auto& heap = out.heap;
+    heap.clear();
+    if (T <= 0 || moves.empty()) return;
+    const auto by_score = [](const Set& a, const Set& b) { return a.score > b.score; }; // min-heap
+    heap.push_back({moves[0].cost, 1});
 
-        for (int i = 0; i < space_dim; i++) {
-            a[i] = floor((x.values[i] - hash_it[i].first) / (p.w * 1.0));
+    const int last_move = static_cast<int>(moves.size()) - 1;
+    while (static_cast<int>(out.sets.size()) < T && !heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), by_score);
+        const Set a = heap.back();
+        heap.pop_back();
+        const int m = 63 - __builtin_clzll(a.moves); // last (most costly) move of the set
+        if (m < last_move) {
+            const uint64_t last = uint64_t{1} << m;
+            heap.push_back({a.score + moves[m + 1].cost - moves[m].cost, (a.moves ^ last) | last << 1});
+            std::push_heap(heap.begin(), heap.end(), by_score);
+            heap.push_back({a.score + moves[m + 1].cost, a.moves | last << 1});
+            std::push_heap(heap.begin(), heap.end(), by_score);
         }
 
-        for (int i = 0; i < space_dim; i++) {
-            h += modulo(modulo(a.at(space_dim - i - 1), p.M) * hash_it[i].second, p.M);
+        bool valid = true;
+        for (uint64_t bits = a.moves; bits && valid; bits &= bits - 1) {
+            const int coord = moves[__builtin_ctzll(bits)].coord;
+            for (uint64_t rest = bits & (bits - 1); rest; rest &= rest - 1)
+                if (moves[__builtin_ctzll(rest)].coord == coord) valid = false;
         }
-
-        result = (result << 32 / p.k) | h % p.M;
+        if (valid) out.sets.push_back(a.moves);
     }
+}
 
-    return modulo(result, p.M);
+uint64_t LSHSearch::key_of(int t, const int* h) const {
+    uint64_t key = 0;
+    for (int j = t * p.k; j < (t + 1) * p.k; ++j)
+        key += key_mult[j] * static_cast<uint64_t>(static_cast<int64_t>(h[j]));
+    return key;
+}
+
+uint32_t LSHSearch::bucket_of(uint64_t key) const {
+    if (table_bits == 0) return 0;
+    return static_cast<uint32_t>((key * 0x9e3779b97f4a7c15ULL) >> (64 - table_bits));
+}
+
+// p.M = table_size (or n / 8) rounded up to a power of two, at most 2^31
+void LSHSearch::set_table_size() {
+    const size_t wanted = p.table_size > 0 ? static_cast<size_t>(p.table_size) : static_cast<size_t>(n_points) / 8;
+    table_bits = 0;
+    while (table_bits < 31 && (size_t(1) << table_bits) < wanted) ++table_bits;
+    p.M = 1u << table_bits;
+}
+
+// points hashed in blocks (in parallel), then two counting passes per
+// table: bucket sizes -> offsets, then ids and keys scattered
+void LSHSearch::build_tables() {
+    constexpr size_t kBlock = 256;
+    const size_t n = static_cast<size_t>(n_points), n_h = static_cast<size_t>(n_hashes());
+    std::vector<uint64_t> keys(static_cast<size_t>(p.L) * n); // [table][point]
+    parallel_for((n + kBlock - 1) / kBlock, p.threads, [&](size_t blk, int) {
+        const size_t lo = blk * kBlock, count = std::min(kBlock, n - lo);
+        std::vector<int> h(count * n_h);
+        hash_points(data[lo], data.stride(), count, h.data());
+        for (size_t i = 0; i < count; ++i)
+            for (int t = 0; t < p.L; ++t) keys[t * n + lo + i] = key_of(t, h.data() + i * n_h);
+    });
+
+    // one table per pool thread: with -affinity its arrays are first-touched
+    // on that thread's NUMA node instead of all on the main thread's
+    lsh_tables.assign(p.L, LSHTable{});
+    parallel_for(static_cast<size_t>(p.L), p.threads, [&](size_t t, int) {
+        const uint64_t* keys_t = keys.data() + t * n;
+        LSHTable& table = lsh_tables[t];
+        std::vector<uint32_t> bucket(n);
+
+        table.offsets.assign(p.M + 1, 0);
+        for (size_t i = 0; i < n; ++i) {
+            bucket[i] = bucket_of(keys_t[i]);
+            ++table.offsets[bucket[i] + 1];
+        }
+        for (uint32_t b = 0; b < p.M; ++b) table.offsets[b + 1] += table.offsets[b];
+
+        std::vector<uint32_t> next(table.offsets.begin(), table.offsets.end() - 1);
+        table.ids.resize(n);
+        table.keys.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            const uint32_t e = next[bucket[i]]++;
+            table.ids[e] = static_cast<int>(i);
+            table.keys[e] = keys_t[i];
+        }
+    }, 1);
 }
 
 SearchResult LSHSearch::search(const Vector& query, const Params& params, int query_id) const {
+    return metrics::dispatch(metrics::GLOBAL_METRIC_CFG, [&](const auto& metric) {
+        return search_impl(metric, query, params, query_id);
+    });
+}
+
+template <typename Metric>
+SearchResult LSHSearch::search_impl(const Metric& metric, const Vector& query, const Params& params, int query_id) const {
     auto t0 = std::chrono::high_resolution_clock::now();
     SearchResult res;
     res.query_id = query_id;
 
-    if (amplified_hash_fns.empty() || data.empty() || space_dim == 0) {
+    if (lsh_tables.empty() || data.empty() || space_dim == 0 ||
+        static_cast<int>(query.values.size()) != space_dim) {
         res.time_ms = std::chrono::duration<double, std::milli>(
             std::chrono::high_resolution_clock::now() - t0
         ).count();
         return res;
     }
 
-    std::vector<std::pair<int, double>> b; // (index, distance)
+    std::vector<std::pair<int, double>> b; // (index, comparison distance)
     b.reserve(n_points);
-    int table_idx = 0;
-
-    // 1. Traverse LSH tables
-    for (const auto& it : amplified_hash_fns) {
-        int bucket_id = assign_to_bucket(it, query);
-        const auto& bucket = lsh_tables.at(table_idx)[bucket_id];
-
-        // 2. Collect candidate distances
-        for (int vec_idx : bucket) {
-            double dist = metrics::distance(
-                query.values,
-                data[vec_idx].values,
-                metrics::GLOBAL_METRIC_CFG
-            );
-            b.push_back({vec_idx, dist});
+    const std::vector<float> q = to_float(query);
+    std::vector<int> h(n_hashes());
+    std::vector<double> frac(n_hashes());
+    hash_points(q.data(), q.size(), 1, h.data(), frac.data());
+
+    // 1. Traverse LSH tables: the query's bucket, then (multi-probe) the
+    // T most likely neighbouring ones
+    // a point colliding with the query in several tables is scored once
+    VisitedSet& seen = VisitedSet::for_thread(n_points);
+    ProbeSets& probes = ProbeSets::for_thread();
+    uint64_t entries = 0;
+    for (int table_idx = 0; table_idx < p.L; ++table_idx) {
+        const LSHTable& table = lsh_tables[table_idx];
+        // 2. Collect candidate distances: only points whose g(x) is `key`
+        const auto probe = [&](uint64_t key) {
+            const uint32_t bucket_id = bucket_of(key);
+            const uint32_t first = table.offsets[bucket_id], last = table.offsets[bucket_id + 1];
+            ++res.stats.buckets_probed;
+            entries += last - first;
+            for (uint32_t e = first; e < last; ++e) {
+                if (table.keys[e] != key) continue;
+                const int id = table.ids[e];
+                ++res.stats.candidates;
+                if (!seen.insert(id)) continue;
+                double dist = metric(q.data(), data[id], space_dim);
+                b.push_back({id, dist});
+            }
+        };
+
+        const uint64_t key = key_of(table_idx, h.data());
+        probe(key);
+        // g is linear in h, so a perturbed key is the key plus r_j * delta_j
+        const int base = table_idx * p.k;
+        probe_sequence(frac.data() + base, p.T, probes);
+        for (uint64_t set : probes.sets) {
+            uint64_t moved = key;
+            for (; set; set &= set - 1) {
+                const auto& move = probes.moves[__builtin_ctzll(set)];
+                moved += key_mult[base + move.coord] * static_cast<uint64_t>(static_cast<int64_t>(move.delta));
+            }
+            probe(moved);
         }
-        ++table_idx;
     }
 
+    res.stats.unique_candidates = b.size();
+    res.stats.distance_computations = b.size();
+    res.stats.bytes_scanned = entries * sizeof(uint64_t) + b.size() * space_dim * sizeof(float);
+
     // 3. Find the R nearest
     if (!b.empty()) {
-        std::partial_sort(
-            b.begin(),
-            b.begin() + params.N,
-            b.end(),
-            [](const auto& a, const auto& b) {
-                return a.second < b.second;
-            }
-        );
+        res.stats.heap_operations = b.size();
+        int topK = select_top_n(b, params.N);
 
-        int topK = std::min(params.N, static_cast<int>(b.size()));
         for (int i = 0; i < topK; ++i) {
             res.neighbor_ids.push_back(b[i].first);
-            res.distances.push_back(static_cast<float>(b[i].second));
+            res.distances.push_back(static_cast<float>(Metric::to_true(b[i].second)));
         }
 
         if (params.enable_range && params.R > 0.0) {
+            const double R_cmp = Metric::to_comparison(params.R);
             for (const auto& cand : b) {
-                if (cand.second <= params.R) {
+                if (cand.second <= R_cmp) {
                     res.range_neighbor_ids.push_back(cand.first);
-                    res.range_distances.push_back(static_cast<float>(cand.second));
+                    res.range_distances.push_back(static_cast<float>(Metric::to_true(cand.second)));
                 } else {
                     break;
                 }
@@ -1,9 +1,47 @@
 #include <iostream>
 #include <unordered_set>
 #include <algorithm>
+#include <cmath>
+#include <sstream>
 
 #include "../../include/common/evaluation_metrics.h"
 
+LatencyStats latency_stats(std::vector<double> times_ms) {
+    LatencyStats s;
+    s.count = times_ms.size();
+    if (times_ms.empty()) return s;
+    std::sort(times_ms.begin(), times_ms.end());
+    s.mean = std::accumulate(times_ms.begin(), times_ms.end(), 0.0) / (double)s.count;
+    // nearest rank: smallest value with at least p% of the samples at or below it
+    auto rank = [&](double p) {
+        size_t k = (size_t)std::ceil(p / 100.0 * (double)s.count);
+        return times_ms[std::min(s.count, std::max<size_t>(k, 1)) - 1];
+    };
+    s.p50 = rank(50.0);
+    s.p90 = rank(90.0);
+    s.p95 = rank(95.0);
+    s.p99 = rank(99.0);
+    s.p999 = rank(99.9);
+    s.max = times_ms.back();
+    return s;
+}
+
+std::string format_work(const SearchStats& total, std::size_t queries) {
+    const double n = queries > 0 ? (double)queries : 1.0;
+    std::ostringstream os;
+    os << "distances=" << total.distance_computations / n << " candidates=" << total.candidates / n
+       << " unique=" << total.unique_candidates / n << " buckets=" << total.buckets_probed / n
+       << " luts=" << total.lut_builds / n << " adc=" << total.adc_evaluations / n
+       << " bytes=" << total.bytes_scanned / n << " heap=" << total.heap_operations / n;
+    return os.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const LatencyStats& s) {
+    if (s.count == 0) return os << "n/a (no per-query times)";
+    return os << "n=" << s.count << " mean=" << s.mean << " p50=" << s.p50 << " p90=" << s.p90
+              << " p95=" << s.p95 << " p99=" << s.p99 << " p99.9=" << s.p999 << " max=" << s.max;
+}
+
 EvalResults evaluate_results(const std::vector<SearchResult>& approx,
                              const std::vector<SearchResult>& truth, 
                              int N,
@@ -43,11 +81,38 @@ EvalResults evaluate_results(const std::vector<SearchResult>& approx,
     r.tApproxAvg = tapprox_sum / (double)qcount;
     r.tTrueAvg = ttrue_sum / (double)qcount;
 
+    // tails over every query with its own time (the averages above skip
+    // queries without results); times split from a batch have no tail
+    std::vector<double> approx_ms, truth_ms;
+    approx_ms.reserve(qcount);
+    truth_ms.reserve(qcount);
+    int threads = 0;
+    r.queries = qcount;
+    for (size_t i = 0; i < qcount; ++i) {
+        r.approx_work += approx[i].stats;
+        approx_ms.push_back(approx[i].time_ms);
+        if (!truth[i].shared_time) truth_ms.push_back(truth[i].time_ms);
+        threads = std::max(threads, approx[i].thread_id + 1);
+    }
+    const bool approx_timed =
+        std::none_of(approx.begin(), approx.end(), [](const SearchResult& res) { return res.shared_time; });
+    if (approx_timed) r.approx_latency = latency_stats(approx_ms);
+    r.truth_latency = latency_stats(std::move(truth_ms));
+    if (threads > 1 && approx_timed) {
+        std::vector<std::vector<double>> per_thread((size_t)threads);
+        for (size_t i = 0; i < qcount; ++i)
+            if (approx[i].thread_id >= 0) per_thread[(size_t)approx[i].thread_id].push_back(approx_ms[i]);
+        for (auto& t : per_thread) r.approx_thread_latency.push_back(latency_stats(std::move(t)));
+    }
+
     std::cout << "[Eval] Average AF=" << r.average_AF << "\n"
               << " Recall@" << N << "=" << r.recall_at_N << "\n"
               << " QPS=" << r.qps << "\n"
               << " TruthQPS=" << truth_qps << "\n"
               << " tApproxAvg=" << r.tApproxAvg << "ms" << "\n"
-              << " tTrueAvg=" << r.tTrueAvg << "ms\n";
+              << " tTrueAvg=" << r.tTrueAvg << "ms\n"
+              << " tApproxLatency(ms) " << r.approx_latency << "\n"
+              << " tTrueLatency(ms) " << r.truth_latency << "\n"
+              << " Work/query " << format_work(r.approx_work, qcount) << "\n";
     return r;
 }
\ No newline at end of file
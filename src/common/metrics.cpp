@@ -1,27 +1,754 @@
 #include <cassert>
 #include <iostream>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define METRICS_X86 1
+#endif
 
 #include "../../include/common/metrics.h"
 
+/*
+    Distance kernels.
+
+    Every kernel exists in a scalar version and, on x86, in SSE, AVX2 and
+    AVX-512 versions compiled with per-function target attributes, so the
+    binary does not need -march flags. The widest level the CPU supports is
+    picked once at startup (CPUID) and stored in a table of function pointers
+    that every public entry point goes through.
+
+    The L2 kernels return the squared sum; euclidean() takes the sqrt.
+
+    Byte (uint8) kernels stay in integer arithmetic and are therefore exact:
+    L1 sums |a - b| with psadbw, L2 widens the bytes to int16, subtracts and
+    squares-and-adds pairs with pmaddwd into int32 lanes. The int32 lanes are
+    flushed to a 64-bit total every kByteBlock elements so they cannot
+    overflow for any dimension. The AVX-512 byte kernels need AVX512BW;
+    without it the AVX2 ones are used.
+*/
+
 namespace metrics {
     MetricConfig GLOBAL_METRIC_CFG;
 
-    double manhattan(const std::vector<double>& a, const std::vector<double>& b) {
-        assert(a.size() == b.size());
+namespace {
+
+    struct Kernels {
+        FloatKernel l1_f;
+        FloatKernel l2sq_f;
+        DoubleKernel l1_d;
+        DoubleKernel l2sq_d;
+        FloatBatchKernel l1_f_batch;
+        FloatBatchKernel l2sq_f_batch;
+        ByteKernel l1_b;
+        ByteKernel l2sq_b;
+        ByteBatchKernel l1_b_batch;
+        ByteBatchKernel l2sq_b_batch;
+        DotPanelKernel dot_panel;
+        DotPanelVecKernel dot_panel_vec;
+    };
+
+    constexpr std::size_t kByteBlock = 8192;
+
+    // Block kernels share the target of the row kernel, so the row kernel
+    // inlines into the loop instead of being called through a pointer per row
+#define METRICS_BATCH_KERNEL(name, row_kernel, ...)                                  \
+    __VA_ARGS__ __attribute__((flatten)) void name(const float* q, const float* rows, std::size_t stride,      \
+                          std::size_t n, std::size_t dim, double* out) {              \
+        for (std::size_t r = 0; r < n; ++r) out[r] = row_kernel(q, rows + r * stride, dim); \
+    }
+
+#define METRICS_BYTE_BATCH_KERNEL(name, row_kernel, ...)                             \
+    __VA_ARGS__ __attribute__((flatten)) void name(const std::uint8_t* q, const std::uint8_t* rows, \
+                          std::size_t stride, std::size_t n, std::size_t dim, double* out) { \
+        for (std::size_t r = 0; r < n; ++r) out[r] = row_kernel(q, rows + r * stride, dim); \
+    }
+
+    // --- Scalar -------------------------------------------------------------
+
+    template <typename T>
+    double l1_scalar(const T* a, const T* b, std::size_t dim) {
         double s = 0.0;
-        for (size_t i=0;i<a.size();++i) s += std::fabs(a[i]-b[i]);
+        for (std::size_t i=0;i<dim;++i) s += std::fabs(static_cast<double>(a[i])-static_cast<double>(b[i]));
         return s;
     }
 
-    double euclidean(const std::vector<double>& a, const std::vector<double>& b) {
-        assert(a.size() == b.size());
+    template <typename T>
+    double l2sq_scalar(const T* a, const T* b, std::size_t dim) {
         double s = 0.0;
-        for (size_t i=0;i<a.size();++i) {
-            double d = a[i]-b[i];
+        for (std::size_t i=0;i<dim;++i) {
+            double d = static_cast<double>(a[i])-static_cast<double>(b[i]);
             s += d*d;
         }
-        return std::sqrt(s);
+        return s;
+    }
+
+    double l1_b_scalar(const std::uint8_t* a, const std::uint8_t* b, std::size_t dim) {
+        std::uint64_t s = 0;
+        for (std::size_t i=0;i<dim;++i) s += static_cast<std::uint64_t>(std::abs(static_cast<int>(a[i]) - static_cast<int>(b[i])));
+        return static_cast<double>(s);
+    }
+
+    double l2sq_b_scalar(const std::uint8_t* a, const std::uint8_t* b, std::size_t dim) {
+        std::uint64_t s = 0;
+        for (std::size_t i=0;i<dim;++i) {
+            const int d = static_cast<int>(a[i]) - static_cast<int>(b[i]);
+            s += static_cast<std::uint64_t>(d*d);
+        }
+        return static_cast<double>(s);
+    }
+
+    // Panel kernels take the base rows in groups of G (the last group repeats
+    // its final row and drops the duplicates): per component, the query lanes
+    // are loaded once and multiplied by one broadcast element of each row.
+    void dot_panel_scalar(const float* panel, const float* xs, std::size_t x_stride,
+                          std::size_t nx, std::size_t dim, float* out) {
+        for (std::size_t j = 0; j < nx; ++j) {
+            const float* x = xs + j * x_stride;
+            float acc[kDotPanel] = {};
+            for (std::size_t k = 0; k < dim; ++k)
+                for (std::size_t t = 0; t < kDotPanel; ++t) acc[t] += panel[k * kDotPanel + t] * x[k];
+            std::copy(acc, acc + kDotPanel, out + j * kDotPanel);
+        }
+    }
+
+    // A single row keeps every lane's sum on one dependency chain in the
+    // kernels above (and wastes the G - 1 duplicate rows): the vec kernels
+    // below split the components over independent chains instead
+    void dot_panel_vec_scalar(const float* panel, const float* x, std::size_t dim, float* out) {
+        dot_panel_scalar(panel, x, 0, 1, dim, out);
+    }
+
+    METRICS_BATCH_KERNEL(l1_f_batch_scalar, l1_scalar<float>, )
+    METRICS_BATCH_KERNEL(l2sq_f_batch_scalar, l2sq_scalar<float>, )
+    METRICS_BYTE_BATCH_KERNEL(l1_b_batch_scalar, l1_b_scalar, )
+    METRICS_BYTE_BATCH_KERNEL(l2sq_b_batch_scalar, l2sq_b_scalar, )
+
+#ifdef METRICS_X86
+
+    // --- SSE (4 floats / 2 doubles) -------------------------------------------
+
+    __attribute__((target("sse2")))
+    double l1_f_sse(const float* a, const float* b, std::size_t dim) {
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        __m128 acc = _mm_setzero_ps();
+        std::size_t i = 0;
+        for (; i + 4 <= dim; i += 4) {
+            __m128 d = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+            acc = _mm_add_ps(acc, _mm_andnot_ps(sign, d));
+        }
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, acc);
+        double s = static_cast<double>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+        return s + l1_scalar(a + i, b + i, dim - i);
+    }
+
+    __attribute__((target("sse2")))
+    double l2sq_f_sse(const float* a, const float* b, std::size_t dim) {
+        __m128 acc = _mm_setzero_ps();
+        std::size_t i = 0;
+        for (; i + 4 <= dim; i += 4) {
+            __m128 d = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+            acc = _mm_add_ps(acc, _mm_mul_ps(d, d));
+        }
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, acc);
+        double s = static_cast<double>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+        return s + l2sq_scalar(a + i, b + i, dim - i);
+    }
+
+    __attribute__((target("sse2")))
+    double l1_d_sse(const double* a, const double* b, std::size_t dim) {
+        const __m128d sign = _mm_set1_pd(-0.0);
+        __m128d acc = _mm_setzero_pd();
+        std::size_t i = 0;
+        for (; i + 2 <= dim; i += 2) {
+            __m128d d = _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i));
+            acc = _mm_add_pd(acc, _mm_andnot_pd(sign, d));
+        }
+        alignas(16) double lanes[2];
+        _mm_store_pd(lanes, acc);
+        return lanes[0] + lanes[1] + l1_scalar(a + i, b + i, dim - i);
+    }
+
+    __attribute__((target("sse2")))
+    double l2sq_d_sse(const double* a, const double* b, std::size_t dim) {
+        __m128d acc = _mm_setzero_pd();
+        std::size_t i = 0;
+        for (; i + 2 <= dim; i += 2) {
+            __m128d d = _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i));
+            acc = _mm_add_pd(acc, _mm_mul_pd(d, d));
+        }
+        alignas(16) double lanes[2];
+        _mm_store_pd(lanes, acc);
+        return lanes[0] + lanes[1] + l2sq_scalar(a + i, b + i, dim - i);
+    }
+
+    // 16 bytes per step
+    __attribute__((target("sse2")))
+    double l1_b_sse(const std::uint8_t* a, const std::uint8_t* b, std::size_t dim) {
+        __m128i acc = _mm_setzero_si128();
+        std::size_t i = 0;
+        for (; i + 16 <= dim; i += 16) {
+            const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+        }
+        alignas(16) std::uint64_t lanes[2];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        return static_cast<double>(lanes[0] + lanes[1]) + l1_b_scalar(a + i, b + i, dim - i);
+    }
+
+    __attribute__((target("sse2")))
+    double l2sq_b_sse(const std::uint8_t* a, const std::uint8_t* b, std::size_t dim) {
+        const __m128i zero = _mm_setzero_si128();
+        std::uint64_t total = 0;
+        std::size_t i = 0;
+        while (i + 16 <= dim) {
+            const std::size_t end = i + std::min(kByteBlock, (dim - i) / 16 * 16);
+            __m128i acc = _mm_setzero_si128();
+            for (; i < end; i += 16) {
+                const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+                const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+                const __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+                const __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(lo, lo));
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(hi, hi));
+            }
+            alignas(16) std::uint32_t lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+            total += std::uint64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+        }
+        return static_cast<double>(total) + l2sq_b_scalar(a + i, b + i, dim - i);
+    }
+
+    // 16 lanes = 4 registers, G = 2 rows
+    __attribute__((target("sse2")))
+    void dot_panel_sse(const float* panel, const float* xs, std::size_t x_stride,
+                       std::size_t nx, std::size_t dim, float* out) {
+        for (std::size_t j = 0; j < nx; j += 2) {
+            const float* x0 = xs + j * x_stride;
+            const float* x1 = j + 1 < nx ? x0 + x_stride : x0;
+            __m128 acc[8];
+            for (auto& a : acc) a = _mm_setzero_ps();
+            for (std::size_t k = 0; k < dim; ++k) {
+                const __m128 b0 = _mm_set1_ps(x0[k]), b1 = _mm_set1_ps(x1[k]);
+                for (int v = 0; v < 4; ++v) {
+                    const __m128 qv = _mm_loadu_ps(panel + k * kDotPanel + 4 * v);
+                    acc[v] = _mm_add_ps(acc[v], _mm_mul_ps(qv, b0));
+                    acc[4 + v] = _mm_add_ps(acc[4 + v], _mm_mul_ps(qv, b1));
+                }
+            }
+            for (int v = 0; v < 4; ++v) _mm_storeu_ps(out + j * kDotPanel + 4 * v, acc[v]);
+            if (j + 1 < nx)
+                for (int v = 0; v < 4; ++v) _mm_storeu_ps(out + (j + 1) * kDotPanel + 4 * v, acc[4 + v]);
+        }
+    }
+
+    // 2 chains (even / odd components) of 4 registers
+    __attribute__((target("sse2")))
+    void dot_panel_vec_sse(const float* panel, const float* x, std::size_t dim, float* out) {
+        __m128 a0[4], a1[4];
+        for (int v = 0; v < 4; ++v) a0[v] = a1[v] = _mm_setzero_ps();
+        std::size_t k = 0;
+        for (; k + 2 <= dim; k += 2) {
+            const __m128 b0 = _mm_set1_ps(x[k]), b1 = _mm_set1_ps(x[k + 1]);
+            for (int v = 0; v < 4; ++v) {
+                a0[v] = _mm_add_ps(a0[v], _mm_mul_ps(_mm_loadu_ps(panel + k * kDotPanel + 4 * v), b0));
+                a1[v] = _mm_add_ps(a1[v], _mm_mul_ps(_mm_loadu_ps(panel + (k + 1) * kDotPanel + 4 * v), b1));
+            }
+        }
+        if (k < dim) {
+            const __m128 b0 = _mm_set1_ps(x[k]);
+            for (int v = 0; v < 4; ++v)
+                a0[v] = _mm_add_ps(a0[v], _mm_mul_ps(_mm_loadu_ps(panel + k * kDotPanel + 4 * v), b0));
+        }
+        for (int v = 0; v < 4; ++v) _mm_storeu_ps(out + 4 * v, _mm_add_ps(a0[v], a1[v]));
+    }
+
+    METRICS_BATCH_KERNEL(l1_f_batch_sse, l1_f_sse, __attribute__((target("sse2"))))
+    METRICS_BATCH_KERNEL(l2sq_f_batch_sse, l2sq_f_sse, __attribute__((target("sse2"))))
+    METRICS_BYTE_BATCH_KERNEL(l1_b_batch_sse, l1_b_sse, __attribute__((target("sse2"))))
+    METRICS_BYTE_BATCH_KERNEL(l2sq_b_batch_sse, l2sq_b_sse, __attribute__((target("sse2"))))
+
+    // --- AVX2 + FMA (8 floats / 4 doubles, two accumulators) ------------------
+
+    __attribute__((target("avx2,fma")))
+    double hsum_avx(__m256 v) {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 0x1));
+        return static_cast<double>(_mm_cvtss_f32(s));
+    }
+
+    __attribute__((target("avx2,fma")))
+    double hsum_avx(__m256d v) {
+        __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+        s = _mm_add_sd(s, _mm_unpackhi_pd(s, s));
+        return _mm_cvtsd_f64(s);
+    }
+
+    __attribute__((target("avx2,fma")))
+    double l1_f_avx2(const float* a, const float* b, std::size_t dim) {
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        std::size_t i = 0;
+        for (; i + 16 <= dim; i += 16) {
+            __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+            __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+            acc0 = _mm256_add_ps(acc0, _mm256_andnot_ps(sign, d0));
+            acc1 = _mm256_add_ps(acc1, _mm256_andnot_ps(sign, d1));
+        }
+        for (; i + 8 <= dim; i += 8) {
+            __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+            acc0 = _mm256_add_ps(acc0, _mm256_andnot_ps(sign, d));
+        }
+        return hsum_avx(_mm256_add_ps(acc0, acc1)) + l1_scalar(a + i, b + i, dim - i);
+    }
+
+    __attribute__((target("avx2,fma")))
+    double l2sq_f_avx2(const float* a, const float* b, std::size_t dim) {
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        std::size_t i = 0;
+        for (; i + 16 <= dim; i += 16) {
+            __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+            __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+            acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+            acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+        }
+        for (; i + 8 <= dim; i += 8) {
+            __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+            acc0 = _mm256_fmadd_ps(d, d, acc0);
+        }
+        return hsum_avx(_mm256_add_ps(acc0, acc1)) + l2sq_scalar(a + i, b + i, dim - i);
+    }
+
+    __attribute__((target("avx2,fma")))
+    double l1_d_avx2(const double* a, const double* b, std::size_t dim) {
+        const __m256d sign = _mm256_set1_pd(-0.0);
+        __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+        std::size_t i = 0;
+        for (; i + 8 <= dim; i += 8) {
+            __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+            __m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4));
+            acc0 = _mm256_add_pd(acc0, _mm256_andnot_pd(sign, d0));
+            acc1 = _mm256_add_pd(acc1, _mm256_andnot_pd(sign, d1));
+        }
+        for (; i + 4 <= dim; i += 4) {
+            __m256d d = _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+            acc0 = _mm256_add_pd(acc0, _mm256_andnot_pd(sign, d));
+        }
+        return hsum_avx(_mm256_add_pd(acc0, acc1)) + l1_scalar(a + i, b + i, dim - i);
+    }
+
+    __attribute__((target("avx2,fma")))
+    double l2sq_d_avx2(const double* a, const double* b, std::size_t dim) {
+        __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+        std::size_t i = 0;
+        for (; i + 8 <= dim; i += 8) {
+            __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+            __m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4));
+            acc0 = _mm256_fmadd_pd(d0, d0, acc0);
+            acc1 = _mm256_fmadd_pd(d1, d1, acc1);
+        }
+        for (; i + 4 <= dim; i += 4) {
+            __m256d d = _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+            acc0 = _mm256_fmadd_pd(d, d, acc0);
+        }
+        return hsum_avx(_mm256_add_pd(acc0, acc1)) + l2sq_scalar(a + i, b + i, dim - i);
+    }
+
+    // 32 bytes per step. flatten (here and in l2sq_b_avx2): the SSE tail is
+    // inlined and VEX-encoded with the rest of the function, rather than a
+    // vzeroupper and a call into the legacy-SSE copy for the last few bytes
+    __attribute__((target("avx2,fma"), flatten))
+    double l1_b_avx2(const std::uint8_t* a, const std::uint8_t* b, std::size_t dim) {
+        __m256i acc = _mm256_setzero_si256();
+        std::size_t i = 0;
+        for (; i + 32 <= dim; i += 32) {
+            const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(va, vb));
+        }
+        alignas(32) std::uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+        return static_cast<double>(lanes[0] + lanes[1] + lanes[2] + lanes[3]) + l1_b_sse(a + i, b + i, dim - i);
+    }
+
+    __attribute__((target("avx2,fma"), flatten))
+    double l2sq_b_avx2(const std::uint8_t* a, const std::uint8_t* b, std::size_t dim) {
+        std::uint64_t total = 0;
+        std::size_t i = 0;
+        while (i + 32 <= dim) {
+            const std::size_t end = i + std::min(kByteBlock, (dim - i) / 32 * 32);
+            __m256i acc = _mm256_setzero_si256();
+            for (; i < end; i += 32) {
+                const __m256i a0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+                const __m256i b0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+                const __m256i a1 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 16)));
+                const __m256i b1 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 16)));
+                const __m256i d0 = _mm256_sub_epi16(a0, b0);
+                const __m256i d1 = _mm256_sub_epi16(a1, b1);
+                acc = _mm256_add_epi32(acc, _mm256_madd_epi16(d0, d0));
+                acc = _mm256_add_epi32(acc, _mm256_madd_epi16(d1, d1));
+            }
+            alignas(32) std::uint32_t lanes[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+            for (std::uint32_t x : lanes) total += x;
+        }
+        return static_cast<double>(total) + l2sq_b_sse(a + i, b + i, dim - i);
+    }
+
+    // 16 lanes = 2 registers, G = 4 rows
+    __attribute__((target("avx2,fma")))
+    void dot_panel_avx2(const float* panel, const float* xs, std::size_t x_stride,
+                        std::size_t nx, std::size_t dim, float* out) {
+        for (std::size_t j = 0; j < nx; j += 4) {
+            const float* x[4];
+            for (std::size_t r = 0; r < 4; ++r) x[r] = xs + std::min(j + r, nx - 1) * x_stride;
+            __m256 acc[8];
+            for (auto& a : acc) a = _mm256_setzero_ps();
+            for (std::size_t k = 0; k < dim; ++k) {
+                const __m256 q0 = _mm256_loadu_ps(panel + k * kDotPanel);
+                const __m256 q1 = _mm256_loadu_ps(panel + k * kDotPanel + 8);
+                for (int r = 0; r < 4; ++r) {
+                    const __m256 b = _mm256_broadcast_ss(x[r] + k);
+                    acc[2 * r] = _mm256_fmadd_ps(q0, b, acc[2 * r]);
+                    acc[2 * r + 1] = _mm256_fmadd_ps(q1, b, acc[2 * r + 1]);
+                }
+            }
+            for (std::size_t r = 0; r < 4 && j + r < nx; ++r) {
+                _mm256_storeu_ps(out + (j + r) * kDotPanel, acc[2 * r]);
+                _mm256_storeu_ps(out + (j + r) * kDotPanel + 8, acc[2 * r + 1]);
+            }
+        }
+    }
+
+    // 4 chains (component k mod 4) of 2 registers
+    __attribute__((target("avx2,fma")))
+    void dot_panel_vec_avx2(const float* panel, const float* x, std::size_t dim, float* out) {
+        __m256 acc[4][2];
+        for (auto& c : acc) c[0] = c[1] = _mm256_setzero_ps();
+        std::size_t k = 0;
+        for (; k + 4 <= dim; k += 4)
+            for (int c = 0; c < 4; ++c) {
+                const __m256 b = _mm256_broadcast_ss(x + k + c);
+                acc[c][0] = _mm256_fmadd_ps(_mm256_loadu_ps(panel + (k + c) * kDotPanel), b, acc[c][0]);
+                acc[c][1] = _mm256_fmadd_ps(_mm256_loadu_ps(panel + (k + c) * kDotPanel + 8), b, acc[c][1]);
+            }
+        for (; k < dim; ++k) {
+            const __m256 b = _mm256_broadcast_ss(x + k);
+            acc[0][0] = _mm256_fmadd_ps(_mm256_loadu_ps(panel + k * kDotPanel), b, acc[0][0]);
+            acc[0][1] = _mm256_fmadd_ps(_mm256_loadu_ps(panel + k * kDotPanel + 8), b, acc[0][1]);
+        }
+        for (int h = 0; h < 2; ++h)
+            _mm256_storeu_ps(out + 8 * h, _mm256_add_ps(_mm256_add_ps(acc[0][h], acc[1][h]),
+                                                        _mm256_add_ps(acc[2][h], acc[3][h])));
+    }
+
+    METRICS_BATCH_KERNEL(l1_f_batch_avx2, l1_f_avx2, __attribute__((target("avx2,fma"))))
+    METRICS_BATCH_KERNEL(l2sq_f_batch_avx2, l2sq_f_avx2, __attribute__((target("avx2,fma"))))
+    METRICS_BYTE_BATCH_KERNEL(l1_b_batch_avx2, l1_b_avx2, __attribute__((target("avx2,fma"))))
+    METRICS_BYTE_BATCH_KERNEL(l2sq_b_batch_avx2, l2sq_b_avx2, __attribute__((target("avx2,fma"))))
+
+    // --- AVX-512 (16 floats / 8 doubles, masked tail) -------------------------
+
+    // horizontal sums go through memory: GCC 12 flags the lane-extract
+    // intrinsics (and _mm512_reduce_add_*) with a false -Wuninitialized
+    __attribute__((target("avx512f")))
+    double hsum_avx512(__m512 v) {
+        alignas(64) float lanes[16];
+        _mm512_store_ps(lanes, v);
+        float s = 0.0f;
+        for (float x : lanes) s += x;
+        return static_cast<double>(s);
+    }
+
+    __attribute__((target("avx512f")))
+    double hsum_avx512(__m512d v) {
+        alignas(64) double lanes[8];
+        _mm512_store_pd(lanes, v);
+        double s = 0.0;
+        for (double x : lanes) s += x;
+        return s;
+    }
+
+    __attribute__((target("avx512f")))
+    double l1_f_avx512(const float* a, const float* b, std::size_t dim) {
+        __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+        std::size_t i = 0;
+        for (; i + 32 <= dim; i += 32) {
+            __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+            __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+            acc0 = _mm512_add_ps(acc0, _mm512_abs_ps(d0));
+            acc1 = _mm512_add_ps(acc1, _mm512_abs_ps(d1));
+        }
+        for (; i < dim; i += 16) {
+            const __mmask16 m = dim - i >= 16 ? static_cast<__mmask16>(0xFFFF)
+                                              : static_cast<__mmask16>((1u << (dim - i)) - 1u);
+            __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i));
+            acc0 = _mm512_add_ps(acc0, _mm512_abs_ps(d));
+        }
+        return hsum_avx512(_mm512_add_ps(acc0, acc1));
+    }
+
+    __attribute__((target("avx512f")))
+    double l2sq_f_avx512(const float* a, const float* b, std::size_t dim) {
+        __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+        std::size_t i = 0;
+        for (; i + 32 <= dim; i += 32) {
+            __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+            __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+            acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+            acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+        }
+        for (; i < dim; i += 16) {
+            const __mmask16 m = dim - i >= 16 ? static_cast<__mmask16>(0xFFFF)
+                                              : static_cast<__mmask16>((1u << (dim - i)) - 1u);
+            __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i));
+            acc0 = _mm512_fmadd_ps(d, d, acc0);
+        }
+        return hsum_avx512(_mm512_add_ps(acc0, acc1));
+    }
+
+    __attribute__((target("avx512f")))
+    double l1_d_avx512(const double* a, const double* b, std::size_t dim) {
+        __m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+        std::size_t i = 0;
+        for (; i + 16 <= dim; i += 16) {
+            __m512d d0 = _mm512_sub_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i));
+            __m512d d1 = _mm512_sub_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8));
+            acc0 = _mm512_add_pd(acc0, _mm512_abs_pd(d0));
+            acc1 = _mm512_add_pd(acc1, _mm512_abs_pd(d1));
+        }
+        for (; i < dim; i += 8) {
+            const __mmask8 m = dim - i >= 8 ? static_cast<__mmask8>(0xFF)
+                                            : static_cast<__mmask8>((1u << (dim - i)) - 1u);
+            __m512d d = _mm512_sub_pd(_mm512_maskz_loadu_pd(m, a + i), _mm512_maskz_loadu_pd(m, b + i));
+            acc0 = _mm512_add_pd(acc0, _mm512_abs_pd(d));
+        }
+        return hsum_avx512(_mm512_add_pd(acc0, acc1));
+    }
+
+    __attribute__((target("avx512f")))
+    double l2sq_d_avx512(const double* a, const double* b, std::size_t dim) {
+        __m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+        std::size_t i = 0;
+        for (; i + 16 <= dim; i += 16) {
+            __m512d d0 = _mm512_sub_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i));
+            __m512d d1 = _mm512_sub_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8));
+            acc0 = _mm512_fmadd_pd(d0, d0, acc0);
+            acc1 = _mm512_fmadd_pd(d1, d1, acc1);
+        }
+        for (; i < dim; i += 8) {
+            const __mmask8 m = dim - i >= 8 ? static_cast<__mmask8>(0xFF)
+                                            : static_cast<__mmask8>((1u << (dim - i)) - 1u);
+            __m512d d = _mm512_sub_pd(_mm512_maskz_loadu_pd(m, a + i), _mm512_maskz_loadu_pd(m, b + i));
+            acc0 = _mm512_fmadd_pd(d, d, acc0);
+        }
+        return hsum_avx512(_mm512_add_pd(acc0, acc1));
+    }
+
+    // 64 bytes per step for L1 (masked tail), 32 widened to int16 for L2
+    __attribute__((target("avx512f,avx512bw")))
+    double l1_b_avx512(const std::uint8_t* a, const std::uint8_t* b, std::size_t dim) {
+        __m512i acc = _mm512_setzero_si512();
+        for (std::size_t i = 0; i < dim; i += 64) {
+            const __mmask64 m = dim - i >= 64 ? ~static_cast<__mmask64>(0)
+                                              : (static_cast<__mmask64>(1) << (dim - i)) - 1;
+            const __m512i va = _mm512_maskz_loadu_epi8(m, a + i);
+            const __m512i vb = _mm512_maskz_loadu_epi8(m, b + i);
+            acc = _mm512_add_epi64(acc, _mm512_sad_epu8(va, vb));
+        }
+        alignas(64) std::uint64_t lanes[8];
+        _mm512_store_si512(lanes, acc);
+        std::uint64_t s = 0;
+        for (std::uint64_t x : lanes) s += x;
+        return static_cast<double>(s);
+    }
+
+    __attribute__((target("avx512f,avx512bw"), flatten)) // see l1_b_avx2
+    double l2sq_b_avx512(const std::uint8_t* a, const std::uint8_t* b, std::size_t dim) {
+        std::uint64_t total = 0;
+        std::size_t i = 0;
+        while (i + 32 <= dim) {
+            const std::size_t end = i + std::min(kByteBlock, (dim - i) / 32 * 32);
+            __m512i acc = _mm512_setzero_si512();
+            for (; i < end; i += 32) {
+                const __m512i va = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+                const __m512i vb = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+                const __m512i d = _mm512_sub_epi16(va, vb);
+                acc = _mm512_add_epi32(acc, _mm512_madd_epi16(d, d));
+            }
+            alignas(64) std::uint32_t lanes[16];
+            _mm512_store_si512(lanes, acc);
+            for (std::uint32_t x : lanes) total += x;
+        }
+        return static_cast<double>(total) + l2sq_b_sse(a + i, b + i, dim - i);
+    }
+
+    // 16 lanes = 1 register, G = 8 rows
+    __attribute__((target("avx512f")))
+    void dot_panel_avx512(const float* panel, const float* xs, std::size_t x_stride,
+                          std::size_t nx, std::size_t dim, float* out) {
+        for (std::size_t j = 0; j < nx; j += 8) {
+            const float* x[8];
+            for (std::size_t r = 0; r < 8; ++r) x[r] = xs + std::min(j + r, nx - 1) * x_stride;
+            __m512 acc[8];
+            for (auto& a : acc) a = _mm512_setzero_ps();
+            for (std::size_t k = 0; k < dim; ++k) {
+                const __m512 qv = _mm512_loadu_ps(panel + k * kDotPanel);
+                for (int r = 0; r < 8; ++r) acc[r] = _mm512_fmadd_ps(qv, _mm512_set1_ps(x[r][k]), acc[r]);
+            }
+            for (std::size_t r = 0; r < 8 && j + r < nx; ++r) _mm512_storeu_ps(out + (j + r) * kDotPanel, acc[r]);
+        }
+    }
+
+    // 4 chains (component k mod 4) of 1 register
+    __attribute__((target("avx512f")))
+    void dot_panel_vec_avx512(const float* panel, const float* x, std::size_t dim, float* out) {
+        __m512 acc[4];
+        for (auto& a : acc) a = _mm512_setzero_ps();
+        std::size_t k = 0;
+        for (; k + 4 <= dim; k += 4)
+            for (int c = 0; c < 4; ++c)
+                acc[c] = _mm512_fmadd_ps(_mm512_loadu_ps(panel + (k + c) * kDotPanel), _mm512_set1_ps(x[k + c]), acc[c]);
+        for (; k < dim; ++k)
+            acc[0] = _mm512_fmadd_ps(_mm512_loadu_ps(panel + k * kDotPanel), _mm512_set1_ps(x[k]), acc[0]);
+        _mm512_storeu_ps(out, _mm512_add_ps(_mm512_add_ps(acc[0], acc[1]), _mm512_add_ps(acc[2], acc[3])));
+    }
+
+    METRICS_BATCH_KERNEL(l1_f_batch_avx512, l1_f_avx512, __attribute__((target("avx512f"))))
+    METRICS_BATCH_KERNEL(l2sq_f_batch_avx512, l2sq_f_avx512, __attribute__((target("avx512f"))))
+    METRICS_BYTE_BATCH_KERNEL(l1_b_batch_avx512, l1_b_avx512, __attribute__((target("avx512f,avx512bw"))))
+    METRICS_BYTE_BATCH_KERNEL(l2sq_b_batch_avx512, l2sq_b_avx512, __attribute__((target("avx512f,avx512bw"))))
+
+#endif // METRICS_X86
+
+#undef METRICS_BATCH_KERNEL
+#undef METRICS_BYTE_BATCH_KERNEL
+
+    Kernels kernels_for(SimdLevel level) {
+        switch (level) {
+#ifdef METRICS_X86
+            case SimdLevel::AVX512:
+                if (__builtin_cpu_supports("avx512bw"))
+                    return {l1_f_avx512, l2sq_f_avx512, l1_d_avx512, l2sq_d_avx512,
+                            l1_f_batch_avx512, l2sq_f_batch_avx512,
+                            l1_b_avx512, l2sq_b_avx512, l1_b_batch_avx512, l2sq_b_batch_avx512,
+                            dot_panel_avx512, dot_panel_vec_avx512};
+                return {l1_f_avx512, l2sq_f_avx512, l1_d_avx512, l2sq_d_avx512,
+                        l1_f_batch_avx512, l2sq_f_batch_avx512,
+                        l1_b_avx2, l2sq_b_avx2, l1_b_batch_avx2, l2sq_b_batch_avx2,
+                        dot_panel_avx512, dot_panel_vec_avx512};
+            case SimdLevel::AVX2:
+                return {l1_f_avx2, l2sq_f_avx2, l1_d_avx2, l2sq_d_avx2,
+                        l1_f_batch_avx2, l2sq_f_batch_avx2,
+                        l1_b_avx2, l2sq_b_avx2, l1_b_batch_avx2, l2sq_b_batch_avx2,
+                        dot_panel_avx2, dot_panel_vec_avx2};
+            case SimdLevel::SSE:
+                return {l1_f_sse, l2sq_f_sse, l1_d_sse, l2sq_d_sse,
+                        l1_f_batch_sse, l2sq_f_batch_sse,
+                        l1_b_sse, l2sq_b_sse, l1_b_batch_sse, l2sq_b_batch_sse,
+                        dot_panel_sse, dot_panel_vec_sse};
+#endif
+            default:
+                return {l1_scalar<float>, l2sq_scalar<float>, l1_scalar<double>, l2sq_scalar<double>,
+                        l1_f_batch_scalar, l2sq_f_batch_scalar,
+                        l1_b_scalar, l2sq_b_scalar, l1_b_batch_scalar, l2sq_b_batch_scalar,
+                        dot_panel_scalar, dot_panel_vec_scalar};
+        }
+    }
+
+    // selected once, during static initialization
+    SimdLevel active_level = detect_simd_level();
+    Kernels active = kernels_for(active_level);
+
+} // namespace
+
+    SimdLevel detect_simd_level() {
+#ifdef METRICS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SimdLevel::AVX2;
+        if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE;
+#endif
+        return SimdLevel::Scalar;
+    }
+
+    SimdLevel active_simd_level() { return active_level; }
+
+    void set_simd_level(SimdLevel level) {
+        // never select an instruction set the CPU cannot execute
+        if (static_cast<int>(level) > static_cast<int>(detect_simd_level())) level = detect_simd_level();
+        active_level = level;
+        active = kernels_for(level);
+    }
+
+    const char* simd_level_name(SimdLevel level) {
+        switch (level) {
+            case SimdLevel::AVX512: return "avx512";
+            case SimdLevel::AVX2: return "avx2";
+            case SimdLevel::SSE: return "sse";
+            default: return "scalar";
+        }
+    }
+
+    FloatKernel float_kernel(MetricType type) {
+        return type == MetricType::L1 ? active.l1_f : active.l2sq_f;
+    }
+
+    DoubleKernel double_kernel(MetricType type) {
+        return type == MetricType::L1 ? active.l1_d : active.l2sq_d;
+    }
+
+    FloatBatchKernel float_batch_kernel(MetricType type) {
+        return type == MetricType::L1 ? active.l1_f_batch : active.l2sq_f_batch;
+    }
+
+    ByteKernel byte_kernel(MetricType type) {
+        return type == MetricType::L1 ? active.l1_b : active.l2sq_b;
+    }
+
+    ByteBatchKernel byte_batch_kernel(MetricType type) {
+        return type == MetricType::L1 ? active.l1_b_batch : active.l2sq_b_batch;
+    }
+
+    DotPanelKernel dot_panel_kernel() { return active.dot_panel; }
+    DotPanelVecKernel dot_panel_vec_kernel() { return active.dot_panel_vec; }
+
+    void pack_dot_panel(const float* qs, std::size_t q_stride, std::size_t nq, std::size_t dim, float* panel) {
+        for (std::size_t k = 0; k < dim; ++k)
+            for (std::size_t t = 0; t < kDotPanel; ++t)
+                panel[k * kDotPanel + t] = t < nq ? qs[t * q_stride + k] : 0.0f;
+    }
+
+    void widened_batch(FloatBatchKernel k, const float* q, const std::uint8_t* rows, std::size_t stride,
+                       std::size_t n, std::size_t dim, double* out) {
+        constexpr std::size_t kRows = 16;
+        thread_local std::vector<float> scratch;
+        scratch.resize(kRows * dim);
+        for (std::size_t r = 0; r < n; r += kRows) {
+            const std::size_t m = std::min(kRows, n - r);
+            for (std::size_t i = 0; i < m; ++i) {
+                const std::uint8_t* src = rows + (r + i) * stride;
+                std::copy(src, src + dim, scratch.data() + i * dim);
+            }
+            k(q, scratch.data(), dim, m, dim, out + r);
+        }
+    }
+
+    double manhattan(const std::vector<double>& a, const std::vector<double>& b) {
+        assert(a.size() == b.size());
+        return active.l1_d(a.data(), b.data(), a.size());
+    }
+
+    double euclidean(const std::vector<double>& a, const std::vector<double>& b) {
+        assert(a.size() == b.size());
+        return std::sqrt(active.l2sq_d(a.data(), b.data(), a.size()));
     }
 
     double distance(const std::vector<double>& a, const std::vector<double>& b, const MetricConfig& cfg) {
@@ -32,6 +759,79 @@ namespace metrics {
         }
     }
 
+    double manhattan(const float* a, const float* b, std::size_t dim) {
+        return active.l1_f(a, b, dim);
+    }
+
+    double euclidean(const float* a, const float* b, std::size_t dim) {
+        return std::sqrt(active.l2sq_f(a, b, dim));
+    }
+
+    double distance(const float* a, const float* b, std::size_t dim, const MetricConfig& cfg) {
+        switch (cfg.type) {
+            case MetricType::L1: return manhattan(a,b,dim);
+            case MetricType::L2: return euclidean(a,b,dim);
+            default: return euclidean(a,b,dim);
+        }
+    }
+
+    double manhattan(const double* a, const double* b, std::size_t dim) {
+        return active.l1_d(a, b, dim);
+    }
+
+    double euclidean(const double* a, const double* b, std::size_t dim) {
+        return std::sqrt(active.l2sq_d(a, b, dim));
+    }
+
+    double distance(const double* a, const double* b, std::size_t dim, const MetricConfig& cfg) {
+        switch (cfg.type) {
+            case MetricType::L1: return manhattan(a,b,dim);
+            case MetricType::L2: return euclidean(a,b,dim);
+            default: return euclidean(a,b,dim);
+        }
+    }
+
+    double distance(const std::uint8_t* a, const std::uint8_t* b, std::size_t dim, const MetricConfig& cfg) {
+        if (cfg.type == MetricType::L1) return active.l1_b(a, b, dim);
+        return std::sqrt(active.l2sq_b(a, b, dim));
+    }
+
+    double squared_euclidean(const float* a, const float* b, std::size_t dim) {
+        return active.l2sq_f(a, b, dim);
+    }
+
+    double squared_euclidean(const double* a, const double* b, std::size_t dim) {
+        return active.l2sq_d(a, b, dim);
+    }
+
+    double comparison_distance(const float* a, const float* b, std::size_t dim, const MetricConfig& cfg) {
+        if (cfg.type == MetricType::L1) return active.l1_f(a, b, dim);
+        return active.l2sq_f(a, b, dim);
+    }
+
+    double comparison_distance(const double* a, const double* b, std::size_t dim, const MetricConfig& cfg) {
+        if (cfg.type == MetricType::L1) return active.l1_d(a, b, dim);
+        return active.l2sq_d(a, b, dim);
+    }
+
+    double comparison_distance(const std::uint8_t* a, const std::uint8_t* b, std::size_t dim, const MetricConfig& cfg) {
+        if (cfg.type == MetricType::L1) return active.l1_b(a, b, dim);
+        return active.l2sq_b(a, b, dim);
+    }
+
+    double comparison_distance(const std::vector<double>& a, const std::vector<double>& b, const MetricConfig& cfg) {
+        assert(a.size() == b.size());
+        return comparison_distance(a.data(), b.data(), a.size(), cfg);
+    }
+
+    double to_comparison_distance(double dist, const MetricConfig& cfg) {
+        return cfg.type == MetricType::L1 ? dist : dist * dist;
+    }
+
+    double to_true_distance(double cmp_dist, const MetricConfig& cfg) {
+        return cfg.type == MetricType::L1 ? cmp_dist : std::sqrt(cmp_dist);
+    }
+
     MetricConfig parse_metric_type(const std::string& name) {
         MetricConfig cfg;
         if (name == "l1" || name == "L1" || name == "manhattan") cfg.type = MetricType::L1;
@@ -41,4 +841,4 @@ namespace metrics {
 
     void set_global_config(const MetricConfig& cfg) { GLOBAL_METRIC_CFG = cfg; }
 
-} // namespace metrics
\ No newline at end of file
+} // namespace metrics
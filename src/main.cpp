@@ -5,6 +5,7 @@
 #include <memory>
 #include <filesystem>
 #include <chrono>
+#include <algorithm>
 
 #include "../include/utils/args_parser.h"
 #include "../include/algorithms/brute_force_search.h"
@@ -14,6 +15,9 @@
 #include "../include/utils/parallel_runner.h"
 #include "../include/utils/data_loader.h"
 #include "../include/utils/result_writer.h"
+#include "../include/utils/truth_cache.h"
+#include "../include/utils/sweep_runner.h"
+#include "../include/utils/numa.h"
 #include "../include/common/metrics.h"
 #include "../include/common/evaluation_metrics.h"
 
@@ -40,17 +44,24 @@ int main(int argc, char** argv) {
     auto mcfg = metrics::parse_metric_type(args.metric);
     metrics::set_global_config(mcfg);
 
+    // Pin worker threads (-affinity) before anything is allocated by them
+    numa::configure(args);
+
     // Load dataset and queries
-    std::vector<Vector> dataset;
+    Dataset dataset;
     std::vector<Vector> queries;
     try {
-        dataset = data_loader::load_dataset(args.dataset_path, args.type);
-        queries = data_loader::load_queries(args.query_path, args.type);
+        dataset = data_loader::load_dataset(args.dataset_path, args.type, args.threads);
+        queries = data_loader::load_queries(args.query_path, args.type, args.threads);
+        // spread the rows over the nodes of the pinned threads (no-op on one node)
+        dataset = numa::first_touch(dataset, args.threads);
     } catch (const std::exception& e) {
         std::cerr << "[Main] Error loading data: " << e.what() << "\n";
         return 1;
     }
 
+    if (!args.sweep.empty()) return run_sweep(args, dataset, queries);
+
     Params params; params.N = args.N; params.R = args.R; params.enable_range = args.range;
     std::cout << "sanity check" << std::endl;
     // Create approx algorithm and configure
@@ -60,26 +71,43 @@ int main(int argc, char** argv) {
     std::cout << "sanity check" << std::endl;
     approx->configure(args);
     std::cout << "sanity check" << std::endl;
-    approx->build_index(dataset);
+    // Reuse the index saved by an earlier run (-index); build and save it otherwise
+    auto tb0 = std::chrono::high_resolution_clock::now();
+    bool loaded = false;
+    if (!args.index_path.empty() && std::filesystem::exists(args.index_path)) {
+        try {
+            loaded = approx->load_index(args.index_path, dataset);
+        } catch (const std::exception& e) {
+            std::cerr << "[Main] Cannot reuse index " << args.index_path << ": " << e.what() << ", rebuilding\n";
+        }
+    }
+    if (!loaded) {
+        approx->build_index(dataset);
+        if (!args.index_path.empty()) {
+            try {
+                if (approx->save_index(args.index_path))
+                    std::cout << "[Main] Index saved to " << args.index_path << "\n";
+                else
+                    std::cout << "[Main] " << approx->name() << " has no saved index format, -index ignored\n";
+            } catch (const std::exception& e) {
+                std::cerr << "[Main] Cannot save index: " << e.what() << "\n";
+            }
+        }
+    }
+    auto tb1 = std::chrono::high_resolution_clock::now();
+    std::cout << "[Main] Index " << (loaded ? "loaded" : "built") << " in "
+              << std::chrono::duration<double>(tb1 - tb0).count() << " sec\n";
     std::cout << "sanity check" << std::endl;
 
-    // Create ground truth and configure (brute)
-    auto truth = std::make_unique<BruteForceSearch>();
-    truth->configure(args);
-    truth->build_index(dataset);
-
-    // Run Ground Truth (brute)
-    std::cout << "[Main] Running truth (BruteForce) ...\n";
-    auto t0 = std::chrono::high_resolution_clock::now();
-    auto truth_results = run_parallel_search(truth.get(), queries, args.threads, params);
-    auto t1 = std::chrono::high_resolution_clock::now();
-    double truth_time_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
-    std::cout << "[Main] Truth (BruteForce) search completed in " << truth_time_ms / 1000 << " sec\n";
+    // Ground truth (brute): reused from the cache when this dataset, query
+    // set, metric, N and R were already evaluated
+    double truth_time_ms = 0.0;
+    auto truth_results = truth_cache::get_truth(args, dataset, queries, params, truth_time_ms);
 
     // Run Given Algorithm (approx)
     std::cout << "[Main] Running approx (" << args.algo << ") ...\n";
     auto ta0 = std::chrono::high_resolution_clock::now();
-    auto approx_results = run_parallel_search(approx.get(), queries, args.threads, params);
+    auto approx_results = run_parallel_search(approx.get(), queries, args.threads, params, args.batch);
     auto ta1 = std::chrono::high_resolution_clock::now();
     double approx_time_ms = std::chrono::duration<double, std::milli>(ta1 - ta0).count();
     std::cout << "[Main] Approx search completed in " << approx_time_ms / 1000 << " sec\n";
@@ -89,7 +117,13 @@ int main(int argc, char** argv) {
     auto eval = evaluate_results(approx_results, truth_results, args.N, approx_time_ms, truth_time_ms);
 
     // Write approx results
-    write_results(approx_results, args.output_path, approx->name(), approx_time_ms, args.config_summary, &truth_results, &eval);
+    WriteOptions write_options;
+    write_options.binary = args.output_format == "binary";
+    write_options.threads = args.threads;
+    auto tw0 = std::chrono::high_resolution_clock::now();
+    write_results(approx_results, args.output_path, approx->name(), approx_time_ms, args.config_summary, &truth_results, &eval, write_options);
+    auto tw1 = std::chrono::high_resolution_clock::now();
+    std::cout << "[Main] Results written in " << std::chrono::duration<double>(tw1 - tw0).count() << " sec\n";
 
     // Summary output
     std::cout << "[Summary] Method=" << approx->name() << "\n"
@@ -98,6 +132,11 @@ int main(int argc, char** argv) {
               << " QPS=" << eval.qps << "\n"
               << " tApproxAvg=" << eval.tApproxAvg << "ms" << "\n"
               << " tTrueAvg=" << eval.tTrueAvg << "ms\n";
+    if (eval.approx_latency.count > 0)
+        std::cout << " tApproxP99=" << eval.approx_latency.p99 << "ms"
+                  << " tApproxMax=" << eval.approx_latency.max << "ms\n";
+    else
+        std::cout << " tApproxP99=n/a (batched)\n";
               
 
     return 0;
@@ -60,13 +60,36 @@ Args parse_args(int argc, char** argv) {
         args.range = (tmp == "true" || tmp == "1" || tmp == "yes");
     }
 
+    // Optional, never prompted
+    if (mp.count("-truth_cache")) args.truth_cache = mp["-truth_cache"];
+    if (args.truth_cache == "none") args.truth_cache.clear();
+    if (mp.count("-index")) args.index_path = mp["-index"];
+    if (mp.count("-sweep")) args.sweep = mp["-sweep"];
+    if (mp.count("-output_format")) args.output_format = mp["-output_format"];
+    if (args.output_format != "text" && args.output_format != "binary") {
+        std::cerr << "Unknown output format " << args.output_format << ", using text\n";
+        args.output_format = "text";
+    }
+    if (mp.count("-batch")) args.batch = std::max(1, std::stoi(mp["-batch"]));
+    if (mp.count("-affinity")) args.affinity = mp["-affinity"];
+    if (mp.count("-numa_nodes")) args.numa_nodes = mp["-numa_nodes"];
+    if (mp.count("-numa_replicate")) {
+        const std::string v = mp["-numa_replicate"];
+        args.numa_replicate = (v == "true" || v == "1" || v == "yes");
+    }
+
     // --- Algorithm-specific interactive options ---
+    // bucket width w on the scale of nearest-neighbour distances, which are
+    // roughly 100-350 for SIFT and 1000-2700 for MNIST pixels
+    const std::string w_default = args.type == "mnist" ? "5000" : "600";
     /* *** LSH Specific Parameters *** */
     if (args.algo == "lsh") {
         args.seed = std::stoi(get_or_prompt("-seed", "Enter seed", "1"));
         args.k = std::stoi(get_or_prompt("-k", "Enter number of hash functions k", "4"));
         args.L = std::stoi(get_or_prompt("-L", "Enter number of hash tables L", "5"));
-        args.w = std::stod(get_or_prompt("-w", "Enter window size w", "4.0"));
+        args.w = std::stod(get_or_prompt("-w", "Enter window size w", w_default));
+        if (mp.count("-table_size")) args.table_size = std::stoi(mp["-table_size"]);
+        if (mp.count("-T")) args.T = std::stoi(mp["-T"]);
     } 
     /* *** Hypercube Specific Parameters *** */
     else if (args.algo == "hypercube") {
@@ -74,7 +97,7 @@ Args parse_args(int argc, char** argv) {
         args.kproj = std::stoi(get_or_prompt("-kproj", "Enter projection dimension (d')", "14"));
         args.M = std::stoi(get_or_prompt("-M", "Enter max candidate points M", "10"));
         args.probes = std::stoi(get_or_prompt("-probes", "Enter max probes", "2"));
-        args.w = std::stod(get_or_prompt("-w", "Enter window size w", "4.0"));
+        args.w = std::stod(get_or_prompt("-w", "Enter window size w", w_default));
     } 
     /* *** IVFFlat Specific Parameters *** */
     else if (args.algo == "ivfflat") {
@@ -119,7 +142,9 @@ Args parse_args(int argc, char** argv) {
                 << "  Threads: " << args.threads << "\n"
                 << "  N=" << args.N << " R=" << args.R
                 << " Range=" << (args.range ? "true" : "false")
-                << "  Seed=" << args.seed << " k=" << args.k << " L=" << args.L << " w=" << args.w << "\n";
+                << "  Seed=" << args.seed << " k=" << args.k << " L=" << args.L << " w=" << args.w
+                << " table_size=" << (args.table_size > 0 ? std::to_string(args.table_size) : "n/8")
+                << " T=" << args.T << "\n";
     } else if (args.algo == "hypercube") {
         std::ostringstream info;
         info << "\n[INFO] Using configuration:\n"
@@ -157,4 +182,32 @@ Args parse_args(int argc, char** argv) {
         std::cout << args.config_summary;
     }
     return args;
-}
\ No newline at end of file
+}
+
+bool set_arg(Args& args, const std::string& name, const std::string& value) {
+    if (name == "N") args.N = std::stoi(value);
+    else if (name == "batch") args.batch = std::max(1, std::stoi(value));
+    else if (name == "R") args.R = std::stod(value);
+    else if (name == "seed") args.seed = std::stoi(value);
+    else if (name == "k") args.k = std::stoi(value);
+    else if (name == "L") args.L = std::stoi(value);
+    else if (name == "w") args.w = std::stod(value);
+    else if (name == "table_size") args.table_size = std::stoi(value);
+    else if (name == "T") args.T = std::stoi(value);
+    else if (name == "kproj") args.kproj = std::stoi(value);
+    else if (name == "probes") args.probes = std::stoi(value);
+    else if (name == "kclusters") args.kclusters = std::stoi(value);
+    else if (name == "nprobe") args.nprobe = std::stoi(value);
+    else if (name == "nbits") args.pq_nbits = std::stoi(value);
+    else if (name == "M") (args.algo == "ivfpq" ? args.pq_M : args.M) = std::stoi(value); // sub-vectors / candidate cap
+    else return false;
+    return true;
+}
+
+bool is_query_param(const Args& args, const std::string& name) {
+    if (name == "N" || name == "R" || name == "batch") return true;
+    if (name == "nprobe") return args.algo == "ivfflat" || args.algo == "ivfpq";
+    if (name == "probes" || name == "M") return args.algo == "hypercube";
+    if (name == "T") return args.algo == "lsh";
+    return false;
+}
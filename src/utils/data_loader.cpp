@@ -1,86 +1,264 @@
 
-#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <iostream>
 #include <vector>
 #include <string>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <algorithm>
 #include <numeric>
+#include <stdexcept>
+#include <filesystem>
 
 #include "../../include/utils/data_loader.h"
+#include "../../include/utils/thread_pool.h"
 
 // Utility function to print sample vectors for verification
-static void print_sample_vectors(const std::vector<Vector>& data, int n = 3) {
+static void print_sample_vectors(const Dataset& data, int n = 3) {
     std::cout << "[Loader] Preview of first " << n << " vectors:\n";
-    for (int i = 0; i < std::min(n, (int)data.size()); ++i) {
+    for (int i = 0; i < std::min(n, (int)data.rows()); ++i) {
         std::cout << "  Vector[" << i << "] = [ ";
-        for (int j = 0; j < std::min((int)data[i].values.size(), 10); ++j)
-            std::cout << data[i].values[j] << " ";
-        if ((int)data[i].values.size() > 10) std::cout << "...";
-        std::cout << "] (dim=" << data[i].values.size() << ")\n";
+        for (int j = 0; j < std::min((int)data.dim(), 10); ++j) {
+            if (data.is_bytes()) std::cout << +data.byte_row(i)[j] << " ";
+            else std::cout << data[i][j] << " ";
+        }
+        if ((int)data.dim() > 10) std::cout << "...";
+        std::cout << "] (dim=" << data.dim() << ")\n";
+    }
+}
+
+static bool has_extension(const std::string& path, const std::string& ext) {
+    return path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+static bool is_vecs_part(const std::string& path) {
+    return has_extension(path, ".fvecs") || has_extension(path, ".bvecs");
+}
+
+// Reads [offset, offset + n) of a file, retrying short reads
+static void read_at(int fd, unsigned char* dst, size_t n, off_t offset, const std::string& path) {
+    while (n > 0) {
+        ssize_t got = ::pread(fd, dst, n, offset);
+        if (got <= 0) throw std::runtime_error("Read failed in " + path);
+        dst += got;
+        n -= static_cast<size_t>(got);
+        offset += got;
     }
 }
 
 namespace data_loader {
 
+// --- Memory-mapped views ---
+template <typename T>
+VecsView<T> map_vecs(const std::string& path) {
+    VecsView<T> v;
+    v.file = std::make_shared<const MappedFile>(path);
+    const size_t size = v.file->size();
+    if (size < 4) return v;
+
+    int32_t dim;
+    std::memcpy(&dim, v.file->data(), 4);
+    if (dim <= 0) throw std::runtime_error("Invalid vecs dimension in " + path);
+    v.dim = static_cast<size_t>(dim);
+    v.record_bytes = 4 + v.dim * sizeof(T);
+    v.rows = size / v.record_bytes;
+    v.first = v.file->data() + 4;
+
+    // Only the last header is checked: reading every one would fault in the whole file
+    if (v.rows > 0) {
+        int32_t last_dim;
+        std::memcpy(&last_dim, v.file->data() + (v.rows - 1) * v.record_bytes, 4);
+        if (last_dim != dim) throw std::runtime_error("Inconsistent vecs dimension in " + path);
+    }
+    return v;
+}
+
+template VecsView<float> map_vecs<float>(const std::string& path);
+template VecsView<int32_t> map_vecs<int32_t>(const std::string& path);
+template VecsView<uint8_t> map_vecs<uint8_t>(const std::string& path);
+
+IdxView map_idx(const std::string& path) {
+    IdxView v;
+    v.file = std::make_shared<const MappedFile>(path);
+    if (v.file->size() < 16) throw std::runtime_error("Truncated IDX file: " + path);
+
+    uint32_t header[4];
+    std::memcpy(header, v.file->data(), 16);
+    v.count = __builtin_bswap32(header[1]);
+    v.rows = __builtin_bswap32(header[2]);
+    v.cols = __builtin_bswap32(header[3]);
+    v.pixels = v.file->data() + 16;
+
+    const size_t available = (v.file->size() - 16) / std::max<size_t>(1, v.rows * v.cols);
+    if (available < v.count) v.count = available;
+    return v;
+}
+
 // --- MNIST Loader ---
-std::vector<Vector> load_mnist(const std::string& path) {
-    std::ifstream f(path, std::ios::binary);
-    if (!f) throw std::runtime_error("Cannot open MNIST file: " + path);
-
-    uint32_t magic, num_images, rows, cols;
-    f.read((char*)&magic, 4); f.read((char*)&num_images, 4);
-    f.read((char*)&rows, 4); f.read((char*)&cols, 4);
-    magic = __builtin_bswap32(magic);
-    num_images = __builtin_bswap32(num_images);
-    rows = __builtin_bswap32(rows);
-    cols = __builtin_bswap32(cols);
-
-    std::vector<Vector> out(num_images);
-    for (uint32_t i = 0; i < num_images; ++i) {
-        out[i].values.resize(rows * cols);
-        for (uint32_t j = 0; j < rows * cols; ++j) {
-            unsigned char pixel;
-            f.read((char*)&pixel, 1);
-            out[i].values[j] = static_cast<double>(pixel);
+// Pixels stay uint8; images are packed into one aligned matrix (the mapped
+// IDX rows directly follow a 16-byte header and are not cache-line aligned)
+Dataset load_mnist(const std::string& path) {
+    IdxView idx = map_idx(path);
+    const size_t pixels = idx.rows * idx.cols;
+
+    ByteMatrix bytes(idx.count, pixels);
+    if (bytes.size() > 0) std::memcpy(bytes.data(), idx.pixels, bytes.bytes());
+    Dataset out(std::move(bytes));
+    std::cout << "[MNIST] loaded " << out.rows() << " images (" << idx.rows << "x" << idx.cols << ", "
+              << out.bytes() / (1024 * 1024) << " MB as uint8)\n";
+    print_sample_vectors(out);
+    return out;
+}
+
+// --- Sharded files ---
+VecsInfo probe_vecs(const std::string& path) {
+    namespace fs = std::filesystem;
+    VecsInfo info;
+    if (fs::is_directory(path)) {
+        for (const auto& entry : fs::directory_iterator(path))
+            if (entry.is_regular_file() && is_vecs_part(entry.path().string()))
+                info.shards.push_back(entry.path().string());
+        std::sort(info.shards.begin(), info.shards.end());
+        if (info.shards.empty()) throw std::runtime_error("No .fvecs/.bvecs parts in " + path);
+    } else {
+        info.shards.push_back(path);
+    }
+
+    for (const std::string& shard : info.shards) {
+        const size_t size = fs::file_size(shard);
+        size_t rows = 0;
+        if (size >= 4) {
+            int fd = ::open(shard.c_str(), O_RDONLY);
+            if (fd < 0) throw std::runtime_error("Cannot open file: " + shard);
+            int32_t dim = 0;
+            try {
+                read_at(fd, reinterpret_cast<unsigned char*>(&dim), 4, 0, shard);
+            } catch (...) {
+                ::close(fd);
+                throw;
+            }
+            ::close(fd);
+            if (dim <= 0) throw std::runtime_error("Invalid vecs dimension in " + shard);
+            if (info.dim == 0) info.dim = static_cast<size_t>(dim);
+            if (info.dim != static_cast<size_t>(dim))
+                throw std::runtime_error("Dimension mismatch between shards in " + path);
+            const size_t elem = has_extension(shard, ".bvecs") ? 1 : 4;
+            rows = size / (4 + info.dim * elem);
         }
+        info.shard_rows.push_back(rows);
+        info.rows += rows;
     }
-    std::cout << "[MNIST] loaded " << out.size() << " images (" << rows << "x" << cols << ")\n";
+    return info;
+}
+
+// --- SIFT Loaders ---
+// A single .fvecs is used in place: the Dataset rows point into the mapping,
+// skipping the 4-byte dimension header of every record
+Dataset load_sift(const std::string& path) {
+    VecsView<float> v = map_vecs<float>(path);
+    Dataset out(v.file, v.rows > 0 ? v.row(0) : nullptr, v.rows, v.dim, v.record_bytes / sizeof(float));
+    std::cout << "[SIFT] mapped " << out.rows() << " vectors of dim " << out.dim() << " ("
+              << v.file->size() / (1024 * 1024) << " MB)\n";
     print_sample_vectors(out);
     return out;
 }
 
-// --- SIFT Loader ---
-std::vector<Vector> load_sift(const std::string& path) {
-    std::ifstream f(path, std::ios::binary);
-    if (!f) throw std::runtime_error("Cannot open SIFT file: " + path);
-    std::vector<Vector> out;
-    while (true) {
-        int dim;
-        if (!f.read((char*)&dim, 4)) break;
-        if (dim != 128) break;
-        Vector v;
-        v.values.resize(dim);
-        std::vector<float> buffer(dim);
-        f.read(reinterpret_cast<char*>(buffer.data()), dim * sizeof(float));
-        if (!f) break;
-        for (int idx = 0; idx < dim; ++idx) v.values[idx] = static_cast<double>(buffer[idx]);
-        out.push_back(std::move(v));
-    }
-    std::cout << "[SIFT] loaded " << out.size() << " vectors\n";
+// A single .bvecs (e.g. SIFT1B) is used in place as uint8 rows
+Dataset load_bvecs(const std::string& path) {
+    VecsView<uint8_t> v = map_vecs<uint8_t>(path);
+    Dataset out(v.file, v.rows > 0 ? v.row(0) : nullptr, v.rows, v.dim, v.record_bytes);
+    std::cout << "[SIFT] mapped " << out.rows() << " byte vectors of dim " << out.dim() << " ("
+              << v.file->size() / (1024 * 1024) << " MB)\n";
     print_sample_vectors(out);
     return out;
 }
 
-std::vector<Vector> load_dataset(const std::string& path, const std::string& type) {
+// Sharded directories are decoded in chunks of rows on `threads` workers,
+// each chunk read with pread straight into its rows of one float32 matrix
+Dataset load_shards(const std::string& path, int threads) {
+    constexpr size_t kChunkRows = size_t(1) << 16;
+    const VecsInfo info = probe_vecs(path);
+    FloatMatrix out(info.rows, info.dim);
+
+    // chunks never straddle shards, so each one is a single contiguous read
+    struct Chunk {
+        size_t shard, first_row, rows, first_id;
+    };
+    std::vector<Chunk> chunks;
+    for (size_t s = 0, id = 0; s < info.shards.size(); id += info.shard_rows[s], ++s)
+        for (size_t r = 0; r < info.shard_rows[s]; r += kChunkRows)
+            chunks.push_back({s, r, std::min(kChunkRows, info.shard_rows[s] - r), id + r});
+
+    std::vector<int> fds(info.shards.size(), -1);
+    auto close_all = [&] {
+        for (int fd : fds)
+            if (fd >= 0) ::close(fd);
+    };
+    for (size_t s = 0; s < info.shards.size(); ++s) {
+        fds[s] = ::open(info.shards[s].c_str(), O_RDONLY);
+        if (fds[s] < 0) {
+            close_all();
+            throw std::runtime_error("Cannot open file: " + info.shards[s]);
+        }
+    }
+
+    try {
+        parallel_for(chunks.size(), threads, [&](size_t c, int) {
+            const Chunk& t = chunks[c];
+            const std::string& shard = info.shards[t.shard];
+            const bool bytes = has_extension(shard, ".bvecs");
+            const size_t record = 4 + info.dim * (bytes ? 1 : 4);
+            std::vector<unsigned char> raw(t.rows * record);
+            read_at(fds[t.shard], raw.data(), raw.size(), static_cast<off_t>(t.first_row * record), shard);
+
+            for (size_t i = 0; i < t.rows; ++i) {
+                const unsigned char* rec = raw.data() + i * record;
+                int32_t dim;
+                std::memcpy(&dim, rec, 4);
+                if (static_cast<size_t>(dim) != info.dim)
+                    throw std::runtime_error("Inconsistent vecs dimension in " + shard);
+                float* row = out[t.first_id + i];
+                if (bytes) {
+                    for (size_t j = 0; j < info.dim; ++j) row[j] = static_cast<float>(rec[4 + j]);
+                } else {
+                    std::memcpy(row, rec + 4, info.dim * sizeof(float));
+                }
+            }
+        }, 1);
+    } catch (...) {
+        close_all();
+        throw;
+    }
+    close_all();
+
+    std::cout << "[SIFT] read " << out.rows() << " vectors of dim " << out.dim() << " from "
+              << info.shards.size() << " part(s) (" << out.bytes() / (1024 * 1024) << " MB)\n";
+    Dataset ds(std::move(out));
+    print_sample_vectors(ds);
+    return ds;
+}
+
+Dataset load_dataset(const std::string& path, const std::string& type, int threads) {
     if (type == "mnist") return load_mnist(path);
-    if (type == "sift") return load_sift(path);
+    if (type == "sift") {
+        if (std::filesystem::is_directory(path)) return load_shards(path, threads);
+        if (has_extension(path, ".bvecs")) return load_bvecs(path);
+        return load_sift(path);
+    }
     throw std::runtime_error("Unknown dataset type: " + type);
 }
 
-std::vector<Vector> load_queries(const std::string& path, const std::string& type) {
-    return load_dataset(path, type);
+std::vector<Vector> load_queries(const std::string& path, const std::string& type, int threads) {
+    Dataset m = load_dataset(path, type, threads);
+    std::vector<Vector> out(m.rows());
+    for (size_t i = 0; i < m.rows(); ++i) {
+        if (m.is_bytes()) row_to_vector(m.byte_row(i), m.dim(), out[i]);
+        else row_to_vector(m[i], m.dim(), out[i]);
+    }
+    return out;
 }
 
-} // namespace data_loader
\ No newline at end of file
+} // namespace data_loader
@@ -0,0 +1,113 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+
+#include "../../include/utils/index_io.h"
+#include "../../include/common/metrics.h"
+#include "../../include/utils/fnv.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char kMagic[8] = {'A', 'N', 'N', 'I', 'D', 'X', 0, 0};
+constexpr std::size_t kAlgoBytes = 16;
+constexpr std::uint64_t kAlign = 64;
+constexpr std::size_t kSampledRows = 1024;
+
+template <typename T>
+std::uint64_t hash_value(const T& v, std::uint64_t h) {
+    return fnv::hash_bytes(&v, sizeof v, h);
+}
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t metric;
+    char algo[kAlgoBytes];
+    std::uint64_t rows;
+    std::uint64_t dim;
+    std::uint64_t fingerprint;
+};
+
+Header make_header(const std::string& algo, const Dataset& dataset) {
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof kMagic);
+    h.version = index_io::kVersion;
+    h.metric = metrics::GLOBAL_METRIC_CFG.type == metrics::MetricType::L1 ? 1 : 2;
+    std::memcpy(h.algo, algo.data(), std::min(algo.size(), kAlgoBytes));
+    h.rows = dataset.rows();
+    h.dim = dataset.dim();
+    h.fingerprint = index_io::fingerprint(dataset);
+    return h;
+}
+
+} // namespace
+
+namespace index_io {
+
+std::uint64_t fingerprint(const Dataset& dataset) {
+    std::uint64_t h = hash_value(static_cast<std::uint64_t>(dataset.rows()), fnv::kOffset);
+    h = hash_value(static_cast<std::uint64_t>(dataset.dim()), h);
+    const std::size_t rows = dataset.rows(), samples = std::min(rows, kSampledRows);
+    std::vector<float> row(dataset.dim());
+    for (std::size_t s = 0; s < samples; ++s) {
+        const std::size_t i = rows * s / samples;
+        if (dataset.is_bytes()) std::copy(dataset.byte_row(i), dataset.byte_row(i) + row.size(), row.begin());
+        else std::copy(dataset.row(i), dataset.row(i) + row.size(), row.begin());
+        h = fnv::hash_bytes(row.data(), row.size() * sizeof(float), h);
+    }
+    return h;
+}
+
+Writer::Writer(const std::string& path, const std::string& algo, const Dataset& dataset)
+    : path_(path), tmp_(path + ".tmp." + std::to_string(::getpid())) {
+    out_.open(tmp_, std::ios::binary | std::ios::trunc);
+    if (!out_) throw std::runtime_error("Cannot write " + tmp_);
+    put(make_header(algo, dataset));
+}
+
+void Writer::write(const void* data, std::uint64_t bytes) {
+    out_.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+    pos_ += bytes;
+}
+
+void Writer::pad() {
+    static const char zeros[kAlign] = {};
+    write(zeros, (kAlign - pos_ % kAlign) % kAlign);
+}
+
+void Writer::finish() {
+    out_.close();
+    if (!out_) throw std::runtime_error("Cannot write " + tmp_);
+    fs::rename(tmp_, path_);
+}
+
+Reader::Reader(const std::string& path, const std::string& algo, const Dataset& dataset)
+    : file_(std::make_shared<const MappedFile>(path)) {
+    const Header h = get<Header>();
+    const Header want = make_header(algo, dataset);
+    if (std::memcmp(h.magic, kMagic, sizeof kMagic) != 0) throw std::runtime_error("not an index file");
+    if (h.version != kVersion)
+        throw std::runtime_error("index format version " + std::to_string(h.version) + ", expected " +
+                                 std::to_string(kVersion));
+    if (std::memcmp(h.algo, want.algo, kAlgoBytes) != 0)
+        throw std::runtime_error("index was built by " + std::string(h.algo, strnlen(h.algo, kAlgoBytes)));
+    if (h.metric != want.metric) throw std::runtime_error("index was built with a different metric");
+    if (h.rows != want.rows || h.dim != want.dim || h.fingerprint != want.fingerprint)
+        throw std::runtime_error("index was built over a different dataset");
+}
+
+const unsigned char* Reader::take(std::uint64_t bytes) {
+    if (bytes > file_->size() - pos_) throw std::runtime_error("truncated index file");
+    const unsigned char* p = file_->data() + pos_;
+    pos_ += bytes;
+    return p;
+}
+
+void Reader::align() {
+    take((kAlign - pos_ % kAlign) % kAlign);
+}
+
+} // namespace index_io
@@ -0,0 +1,276 @@
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+#include "../../include/utils/numa.h"
+#include "../../include/utils/thread_pool.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+thread_local int tls_node = 0;
+numa::Placement active_placement;
+
+std::vector<int> allowed_cpus() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    std::vector<int> cpus;
+    if (sched_getaffinity(0, sizeof set, &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE; ++c)
+            if (CPU_ISSET(c, &set)) cpus.push_back(c);
+    }
+    if (cpus.empty()) {
+        const int n = std::max(1u, std::thread::hardware_concurrency());
+        for (int c = 0; c < n; ++c) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+// keeps the allowed CPUs of every node and drops nodes left without any
+numa::Topology restrict_to_allowed(const numa::Topology& topology) {
+    const std::vector<int> allowed = allowed_cpus();
+    numa::Topology out;
+    for (const auto& cpus : topology.node_cpus) {
+        std::vector<int> kept;
+        for (int c : cpus)
+            if (std::find(allowed.begin(), allowed.end(), c) != allowed.end()) kept.push_back(c);
+        if (!kept.empty()) out.node_cpus.push_back(std::move(kept));
+    }
+    return out;
+}
+
+std::string format_cpus(const std::vector<int>& cpus) {
+    std::ostringstream s;
+    for (std::size_t i = 0; i < cpus.size(); ++i) s << (i ? "," : "") << cpus[i];
+    return s.str();
+}
+
+// pinned slots among the first `threads`, grouped by node
+std::vector<std::vector<int>> slots_by_node(int threads) {
+    std::vector<std::vector<int>> by_node;
+    if (!active_placement.active()) return by_node;
+    for (int s = 0; s < std::max(1, threads); ++s) {
+        const int node = active_placement.nodes[static_cast<std::size_t>(s) % active_placement.nodes.size()];
+        if (node >= static_cast<int>(by_node.size())) by_node.resize(node + 1);
+        by_node[node].push_back(s);
+    }
+    return by_node;
+}
+
+// rows [lo, hi) of src into dst (same shape, every element of dst written)
+template <typename T>
+void copy_rows(const Dataset& src, Matrix<T>& dst, std::size_t lo, std::size_t hi) {
+    const std::size_t dim = src.dim(), stride = dst.stride();
+    for (std::size_t i = lo; i < hi; ++i) {
+        const T* from;
+        if constexpr (std::is_same_v<T, float>) from = src.row(i);
+        else from = src.byte_row(i);
+        T* to = dst[i];
+        std::memcpy(to, from, dim * sizeof(T));
+        std::fill(to + dim, to + stride, T(0));
+    }
+}
+
+// a copy of src whose row blocks are written by the given slots
+template <typename T>
+Dataset copy_by_slots(const Dataset& src, const std::vector<std::vector<int>>& writers, int threads) {
+    Matrix<T> out(src.rows(), src.dim(), 1, typename Matrix<T>::Uninitialized{});
+    std::vector<std::pair<std::size_t, std::size_t>> block(static_cast<std::size_t>(std::max(1, threads)), {0, 0});
+    for (const auto& slots : writers)
+        for (std::size_t k = 0; k < slots.size(); ++k)
+            block[slots[k]] = {src.rows() * k / slots.size(), src.rows() * (k + 1) / slots.size()};
+    ThreadPool::instance().run_per_slot(threads, [&](int slot) {
+        copy_rows(src, out, block[slot].first, block[slot].second);
+    });
+    return Dataset(std::move(out));
+}
+
+Dataset copy_by_slots(const Dataset& src, const std::vector<std::vector<int>>& writers, int threads) {
+    if (src.is_bytes()) return copy_by_slots<std::uint8_t>(src, writers, threads);
+    return copy_by_slots<float>(src, writers, threads);
+}
+
+} // namespace
+
+namespace numa {
+
+int Topology::node_of(int cpu) const {
+    for (int n = 0; n < nodes(); ++n)
+        if (std::find(node_cpus[n].begin(), node_cpus[n].end(), cpu) != node_cpus[n].end()) return n;
+    return 0;
+}
+
+std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+        part.erase(std::remove_if(part.begin(), part.end(), ::isspace), part.end());
+        if (part.empty()) continue;
+        const std::size_t dash = part.find('-');
+        if (part.find_first_not_of("0123456789-") != std::string::npos || dash == 0 || dash + 1 == part.size() ||
+            (dash != std::string::npos && part.find('-', dash + 1) != std::string::npos))
+            throw std::runtime_error("Invalid CPU list: " + list);
+        const int lo = std::stoi(part.substr(0, dash));
+        const int hi = dash == std::string::npos ? lo : std::stoi(part.substr(dash + 1));
+        if (hi < lo) throw std::runtime_error("Invalid CPU list: " + list);
+        for (int c = lo; c <= hi; ++c) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+Topology parse_topology(const std::string& spec) {
+    Topology t;
+    std::stringstream ss(spec);
+    std::string node;
+    while (std::getline(ss, node, ';')) {
+        std::vector<int> cpus = parse_cpu_list(node);
+        if (!cpus.empty()) t.node_cpus.push_back(std::move(cpus));
+    }
+    if (t.node_cpus.empty()) throw std::runtime_error("Invalid NUMA node list: " + spec);
+    return t;
+}
+
+Topology detect_topology() {
+    Topology t;
+    const fs::path root("/sys/devices/system/node");
+    std::vector<std::pair<int, std::vector<int>>> found;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(root, ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.compare(0, 4, "node") != 0 || name.size() == 4 ||
+            !std::all_of(name.begin() + 4, name.end(), ::isdigit))
+            continue;
+        std::ifstream in(entry.path() / "cpulist");
+        std::string list;
+        if (!std::getline(in, list)) continue;
+        try {
+            std::vector<int> cpus = parse_cpu_list(list);
+            if (!cpus.empty()) found.emplace_back(std::stoi(name.substr(4)), std::move(cpus));
+        } catch (const std::exception&) {
+            continue; // unreadable entry: treated as a node without CPUs
+        }
+    }
+    std::sort(found.begin(), found.end());
+    for (auto& f : found) t.node_cpus.push_back(std::move(f.second));
+    if (t.node_cpus.empty()) t.node_cpus.push_back(allowed_cpus());
+    return t;
+}
+
+Placement plan_placement(const Topology& topology, const std::string& policy, int threads) {
+    Placement p;
+    if (policy.empty() || policy == "none" || topology.nodes() == 0) return p;
+    const int slots = std::max(1, threads);
+    if (policy == "compact") {
+        std::vector<std::pair<int, int>> order; // (cpu, node), node by node
+        for (int n = 0; n < topology.nodes(); ++n)
+            for (int c : topology.node_cpus[n]) order.emplace_back(c, n);
+        for (int s = 0; s < slots; ++s) {
+            const auto& [cpu, node] = order[static_cast<std::size_t>(s) % order.size()];
+            p.cpus.push_back(cpu);
+            p.nodes.push_back(node);
+        }
+    } else if (policy == "scatter") {
+        for (int s = 0; s < slots; ++s) {
+            const int node = s % topology.nodes();
+            const auto& cpus = topology.node_cpus[node];
+            p.cpus.push_back(cpus[static_cast<std::size_t>(s / topology.nodes()) % cpus.size()]);
+            p.nodes.push_back(node);
+        }
+    } else {
+        const std::vector<int> cpus = parse_cpu_list(policy);
+        if (cpus.empty()) throw std::runtime_error("Invalid affinity: " + policy);
+        for (int s = 0; s < slots; ++s) {
+            const int cpu = cpus[static_cast<std::size_t>(s) % cpus.size()];
+            p.cpus.push_back(cpu);
+            p.nodes.push_back(topology.node_of(cpu));
+        }
+    }
+    return p;
+}
+
+bool pin_current_thread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof set, &set) == 0;
+}
+
+int current_node() { return tls_node; }
+void set_current_node(int node) { tls_node = node; }
+
+void configure(const Args& args) {
+    if (args.affinity.empty() || args.affinity == "none") return;
+    Topology topology;
+    try {
+        topology = args.numa_nodes.empty() ? detect_topology() : parse_topology(args.numa_nodes);
+        topology = restrict_to_allowed(topology);
+        if (topology.nodes() == 0) throw std::runtime_error("no allowed CPU on any node");
+        active_placement = plan_placement(topology, args.affinity, args.threads);
+    } catch (const std::exception& e) {
+        std::cerr << "[NUMA] " << e.what() << ", threads left unpinned\n";
+        return;
+    }
+    if (!pin_current_thread(active_placement.cpus[0])) {
+        std::cerr << "[NUMA] cannot pin to CPU " << active_placement.cpus[0] << ", threads left unpinned\n";
+        active_placement = Placement();
+        return;
+    }
+    const std::vector<int> allowed = allowed_cpus();
+    for (int cpu : active_placement.cpus)
+        if (std::find(allowed.begin(), allowed.end(), cpu) == allowed.end()) {
+            std::cerr << "[NUMA] CPU " << cpu << " is not available, its slots run unpinned\n";
+            break;
+        }
+    ThreadPool::instance().set_placement(active_placement.cpus, active_placement.nodes);
+
+    std::cout << "[NUMA] " << topology.nodes() << " node(s)" << (args.numa_nodes.empty() ? "" : " (emulated)") << ":";
+    for (int n = 0; n < topology.nodes(); ++n) std::cout << " [" << format_cpus(topology.node_cpus[n]) << "]";
+    std::cout << "\n[NUMA] affinity " << args.affinity << ": slot CPUs " << format_cpus(active_placement.cpus) << "\n";
+}
+
+int active_nodes(int threads) {
+    int nodes = 0;
+    for (const auto& slots : slots_by_node(threads)) nodes += slots.empty() ? 0 : 1;
+    return std::max(1, nodes);
+}
+
+Dataset first_touch(const Dataset& dataset, int threads) {
+    if (active_nodes(threads) < 2 || dataset.empty()) return dataset;
+    std::vector<std::vector<int>> all(1);
+    for (int s = 0; s < std::max(1, threads); ++s) all[0].push_back(s);
+    Dataset out = copy_by_slots(dataset, all, threads);
+    std::cout << "[NUMA] dataset rows first-touched by " << all[0].size() << " pinned threads over "
+              << active_nodes(threads) << " nodes\n";
+    return out;
+}
+
+std::vector<Dataset> replicate(const Dataset& dataset, int threads) {
+    std::vector<Dataset> replicas;
+    if (active_nodes(threads) < 2 || dataset.empty()) return replicas;
+    const auto by_node = slots_by_node(threads);
+    replicas.resize(by_node.size());
+    for (std::size_t n = 0; n < by_node.size(); ++n) {
+        if (by_node[n].empty()) continue;
+        std::vector<std::vector<int>> writers{by_node[n]};
+        replicas[n] = copy_by_slots(dataset, writers, threads);
+    }
+    std::cout << "[NUMA] " << active_nodes(threads) << " node-local replicas of " << dataset.bytes() / (1024 * 1024)
+              << " MB\n";
+    return replicas;
+}
+
+} // namespace numa
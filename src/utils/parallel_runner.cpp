@@ -1,41 +1,39 @@
-#include <thread>
-#include <atomic>
+#include <algorithm>
 #include <iostream>
 
 #include "../../include/utils/parallel_runner.h"
+#include "../../include/utils/thread_pool.h"
 
 std::vector<SearchResult> run_parallel_search(
     const SearchAlgorithm* algo,
     const std::vector<Vector>& queries,
     int num_threads,
-    const Params& params
+    const Params& params,
+    int batch
 ) {
     std::vector<SearchResult> results(queries.size());
-    std::atomic<int> counter(0);
 
-    auto worker = [&]() {
-        while (true) {
-            int i = counter++;
-            if (i >= (int)queries.size()) break;
-            results[i] = algo->search(queries[i], params, i);
-            // if(i == 10 ){
-            //     std::cout << "sanity check parallel_runner \n \t quiry counter: " << i << std::endl;
-            //     break;
-            // }
-        }
-    };
-
-    std::vector<std::thread> threads;
-    for (int t = 0; t < num_threads; ++t){
-
-        threads.emplace_back(worker);
-    }
-
-    for (auto& t : threads) {
-
-        t.join();
+    // queries are claimed in chunks from per-thread ranges of the shared pool;
+    // idle threads steal from busy ones, so uneven query costs still balance
+    if (batch <= 1) {
+        parallel_for(queries.size(), num_threads, [&](size_t i, int thread_id) {
+            results[i] = algo->search(queries[i], params, static_cast<int>(i));
+            results[i].thread_id = thread_id;
+        });
+    } else {
+        const size_t size = static_cast<size_t>(batch);
+        const size_t n_batches = (queries.size() + size - 1) / size;
+        parallel_for(n_batches, num_threads, [&](size_t b, int thread_id) {
+            const size_t lo = b * size, hi = std::min(queries.size(), lo + size);
+            std::vector<SearchResult> out = algo->search_batch(queries.data() + lo, hi - lo, params);
+            for (size_t j = 0; j < out.size(); ++j) {
+                out[j].query_id = static_cast<int>(lo + j);
+                out[j].thread_id = thread_id;
+                results[lo + j] = std::move(out[j]);
+            }
+        }, 1);
     }
 
     std::cout << "[Parallel] Completed all queries with " << num_threads << " threads.\n";
     return results;
-}
\ No newline at end of file
+}
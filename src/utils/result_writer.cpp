@@ -1,13 +1,147 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <iomanip>
 #include <filesystem>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "../../include/utils/result_writer.h"
 #include "../../include/common/evaluation_metrics.h"
+#include "../../include/utils/thread_pool.h"
 
-void write_results(const std::vector<SearchResult>& results, const std::string& path, const std::string& method_name, double approx_time_ms, const std::string& config_summary, const std::vector<SearchResult>* truth_results, const EvalResults* eval_summary) {
+namespace {
+
+// queries formatted per round; bounds the text held in memory
+constexpr std::size_t kFormatBatch = 4096;
+// queries per formatted piece; pieces are written in query order
+constexpr std::size_t kFormatPiece = 64;
+
+void append_int(std::string& out, long long v) {
+    char buf[24];
+    out.append(buf, std::to_chars(buf, buf + sizeof buf, v).ptr);
+}
+
+// same text as `<< std::fixed << std::setprecision(6)`
+void append_fixed(std::string& out, float v) {
+    char buf[64];
+    const auto res = std::to_chars(buf, buf + sizeof buf, static_cast<double>(v), std::chars_format::fixed, 6);
+    if (res.ec == std::errc()) out.append(buf, res.ptr);
+    else out += std::to_string(v); // larger than the buffer (not reachable for finite floats)
+}
+
+void format_query(std::string& out, const SearchResult& r, const SearchResult* truth) {
+    out += "Query: ";
+    append_int(out, r.query_id);
+    out += '\n';
+    const std::size_t K = r.neighbor_ids.size();
+    for (std::size_t i = 0; i < K; ++i) {
+        const float approx_dist = i < r.distances.size() ? r.distances[i] : 0.0f;
+        const float true_dist = truth && i < truth->distances.size() ? truth->distances[i] : approx_dist;
+        out += "Nearest neighbor-";
+        append_int(out, static_cast<long long>(i + 1));
+        out += ": ";
+        append_int(out, r.neighbor_ids[i]);
+        out += "\ndistanceApproximate: ";
+        append_fixed(out, approx_dist);
+        out += "\ndistanceTrue: ";
+        append_fixed(out, true_dist);
+        out += '\n';
+    }
+    if (!r.range_neighbor_ids.empty()) {
+        out += "R-near neighbors:\n";
+        for (std::size_t idx = 0; idx < r.range_neighbor_ids.size(); ++idx) {
+            append_int(out, r.range_neighbor_ids[idx]);
+            out += " (dist=";
+            append_fixed(out, r.range_distances[idx]);
+            out += ")\n";
+        }
+    }
+    out += "\n=============================================================\n";
+}
+
+void write_text_results(std::ofstream& out, const std::vector<SearchResult>& results,
+                        const std::vector<SearchResult>* truth_results, int threads) {
+    std::vector<std::string> pieces(kFormatBatch / kFormatPiece);
+    for (std::size_t begin = 0; begin < results.size(); begin += kFormatBatch) {
+        const std::size_t end = std::min(results.size(), begin + kFormatBatch);
+        const std::size_t n_pieces = (end - begin + kFormatPiece - 1) / kFormatPiece;
+        parallel_for(n_pieces, threads, [&](std::size_t p, int) {
+            std::string& piece = pieces[p];
+            piece.clear();
+            const std::size_t lo = begin + p * kFormatPiece, hi = std::min(end, lo + kFormatPiece);
+            for (std::size_t q = lo; q < hi; ++q) {
+                const SearchResult* truth = truth_results && q < truth_results->size() ? &(*truth_results)[q] : nullptr;
+                format_query(piece, results[q], truth);
+            }
+        }, 1);
+        for (std::size_t p = 0; p < n_pieces; ++p)
+            out.write(pieces[p].data(), static_cast<std::streamsize>(pieces[p].size()));
+    }
+}
+
+template <typename T, typename Get>
+void write_vecs(const std::string& path, const std::vector<SearchResult>& results, Get get) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("cannot open " + path);
+    std::vector<T> rec;
+    for (const SearchResult& r : results) {
+        get(r, rec);
+        const std::int32_t n = static_cast<std::int32_t>(rec.size());
+        out.write(reinterpret_cast<const char*>(&n), sizeof n);
+        out.write(reinterpret_cast<const char*>(rec.data()), static_cast<std::streamsize>(rec.size() * sizeof(T)));
+    }
+    if (!out) throw std::runtime_error("cannot write " + path);
+}
+
+void write_range_csr(const std::string& path, const std::vector<SearchResult>& results) {
+    std::vector<std::uint64_t> offsets(1, 0);
+    for (const SearchResult& r : results) offsets.push_back(offsets.back() + r.range_neighbor_ids.size());
+    const std::uint64_t header[2] = {results.size(), offsets.back()};
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("cannot open " + path);
+    out.write(reinterpret_cast<const char*>(header), sizeof header);
+    out.write(reinterpret_cast<const char*>(offsets.data()), static_cast<std::streamsize>(offsets.size() * sizeof(std::uint64_t)));
+    for (const SearchResult& r : results) {
+        const std::vector<std::int32_t> ids(r.range_neighbor_ids.begin(), r.range_neighbor_ids.end());
+        out.write(reinterpret_cast<const char*>(ids.data()), static_cast<std::streamsize>(ids.size() * sizeof(std::int32_t)));
+    }
+    for (const SearchResult& r : results)
+        out.write(reinterpret_cast<const char*>(r.range_distances.data()),
+                  static_cast<std::streamsize>(r.range_distances.size() * sizeof(float)));
+    if (!out) throw std::runtime_error("cannot write " + path);
+}
+
+void write_binary_results(std::ofstream& out, const std::string& path, const std::vector<SearchResult>& results,
+                          const std::vector<SearchResult>* truth_results) {
+    write_vecs<std::int32_t>(path + ".ivecs", results, [](const SearchResult& r, std::vector<std::int32_t>& rec) {
+        rec.assign(r.neighbor_ids.begin(), r.neighbor_ids.end());
+    });
+    write_vecs<float>(path + ".fvecs", results, [](const SearchResult& r, std::vector<float>& rec) {
+        rec.assign(r.distances.begin(), r.distances.end());
+    });
+    out << "Binary results: " << path << ".ivecs (ids), " << path << ".fvecs (distances)";
+    if (truth_results && truth_results->size() == results.size()) {
+        write_vecs<float>(path + ".true.fvecs", *truth_results, [](const SearchResult& r, std::vector<float>& rec) {
+            rec.assign(r.distances.begin(), r.distances.end());
+        });
+        out << ", " << path << ".true.fvecs (true distances)";
+    }
+    const bool any_range = std::any_of(results.begin(), results.end(),
+                                       [](const SearchResult& r) { return !r.range_neighbor_ids.empty(); });
+    if (any_range) {
+        write_range_csr(path + ".range", results);
+        out << ", " << path << ".range (range hits, CSR)";
+    }
+    out << "\n";
+}
+
+} // namespace
+
+void write_results(const std::vector<SearchResult>& results, const std::string& path, const std::string& method_name, double approx_time_ms, const std::string& config_summary, const std::vector<SearchResult>* truth_results, const EvalResults* eval_summary, const WriteOptions& options) {
     std::filesystem::create_directories(std::filesystem::path(path).parent_path());
     std::vector<char> stream_buffer(1 << 20); // 1 MB buffer
     std::ofstream out;
@@ -28,35 +162,23 @@ void write_results(const std::vector<SearchResult>& results, const std::string&
         out << "QPS: " << eval_summary->qps << "\n";
         out << "tApproximateAverage: " << eval_summary->tApproxAvg << "\n";
         out << "tTrueAverage: " << eval_summary->tTrueAvg << "\n";
+        out << "tApproximateLatency (ms): " << eval_summary->approx_latency << "\n";
+        out << "tTrueLatency (ms): " << eval_summary->truth_latency << "\n";
+        out << "Work per query (mean): " << format_work(eval_summary->approx_work, eval_summary->queries) << "\n";
+        for (size_t t = 0; t < eval_summary->approx_thread_latency.size(); ++t)
+            out << "tApproximateLatency[thread " << t << "] (ms): " << eval_summary->approx_thread_latency[t] << "\n";
     }
     out << "=============================================================\n";
-    out << std::fixed << std::setprecision(6);
-    for (size_t query_idx = 0; query_idx < results.size(); ++query_idx) {
-        const auto& r = results[query_idx];
-        const SearchResult* truth = (truth_results && query_idx < truth_results->size())
-                                        ? &(*truth_results)[query_idx]
-                                        : nullptr;
-        out << "Query: " << r.query_id << "\n";
-        int K = static_cast<int>(r.neighbor_ids.size());
-        for (int i = 0; i < K; ++i) {
-            float approx_dist = (i < static_cast<int>(r.distances.size())) ? r.distances[i] : 0.0f;
-            float true_dist = approx_dist;
-            if (truth && i < static_cast<int>(truth->distances.size())) {
-                true_dist = truth->distances[i];
-            }
-            out << "Nearest neighbor-" << (i + 1) << ": " << r.neighbor_ids[i] << "\n";
-            out << "distanceApproximate: " << approx_dist << "\n";
-            out << "distanceTrue: " << true_dist << "\n";
-        }
-        if (!r.range_neighbor_ids.empty()) {
-            out << "R-near neighbors:\n";
-            for (size_t idx = 0; idx < r.range_neighbor_ids.size(); ++idx) {
-                out << r.range_neighbor_ids[idx] << " (dist=" << r.range_distances[idx] << ")\n";
-            }
+    if (options.binary) {
+        try {
+            write_binary_results(out, path, results, truth_results);
+        } catch (const std::exception& e) {
+            std::cerr << "[Writer] " << e.what() << "\n";
+            return;
         }
-        out << "\n";
-        out << "=============================================================\n";
+    } else {
         /* Evaluation Metrics Are Written In Summary*/
+        write_text_results(out, results, truth_results, options.threads);
     }
     std::cout << "[Writer] " << results.size() << " Results written to " << path << " (method: " << method_name << ").\n";
-}
\ No newline at end of file
+}
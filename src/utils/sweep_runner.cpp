@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "../../include/utils/sweep_runner.h"
+#include "../../include/utils/algorithm_factory.h"
+#include "../../include/utils/parallel_runner.h"
+#include "../../include/utils/truth_cache.h"
+#include "../../include/common/evaluation_metrics.h"
+
+namespace {
+
+struct Truth {
+    std::vector<SearchResult> results;
+    double time_ms = 0.0;
+};
+
+struct Axis {
+    std::string name;
+    std::vector<std::string> values;
+};
+
+std::vector<std::string> split(const std::string& s, char sep) {
+    std::vector<std::string> parts;
+    std::stringstream ss(s);
+    std::string part;
+    while (std::getline(ss, part, sep))
+        if (!part.empty()) parts.push_back(part);
+    return parts;
+}
+
+std::vector<Axis> parse_spec(const Args& args) {
+    std::vector<Axis> axes;
+    for (const std::string& item : split(args.sweep, ';')) {
+        const auto eq = item.find('=');
+        if (eq == std::string::npos) throw std::runtime_error("Bad sweep axis (expected name=v1,v2): " + item);
+        Axis axis{item.substr(0, eq), split(item.substr(eq + 1), ',')};
+        if (axis.values.empty()) throw std::runtime_error("Sweep axis without values: " + axis.name);
+        for (const auto& a : axes)
+            if (a.name == axis.name) throw std::runtime_error("Sweep axis given twice: " + axis.name);
+        // validate every value up front instead of failing after some builds
+        Args probe = args;
+        for (const std::string& v : axis.values) {
+            try {
+                if (!set_arg(probe, axis.name, v)) throw std::runtime_error("Unknown sweep parameter: " + axis.name);
+            } catch (const std::logic_error&) { // stoi/stod
+                throw std::runtime_error("Bad value for " + axis.name + ": " + v);
+            }
+        }
+        axes.push_back(std::move(axis));
+    }
+    if (axes.empty()) throw std::runtime_error("Empty sweep spec");
+    return axes;
+}
+
+// All value combinations of `axes` (last axis varies fastest)
+std::vector<std::vector<std::string>> combinations(const std::vector<Axis>& axes) {
+    std::vector<std::vector<std::string>> out(1);
+    for (const Axis& axis : axes) {
+        std::vector<std::vector<std::string>> next;
+        for (const auto& prefix : out)
+            for (const std::string& v : axis.values) {
+                next.push_back(prefix);
+                next.back().push_back(v);
+            }
+        out = std::move(next);
+    }
+    return out;
+}
+
+Args with_values(Args args, const std::vector<Axis>& axes, const std::vector<std::string>& values) {
+    for (std::size_t i = 0; i < axes.size(); ++i) set_arg(args, axes[i].name, values[i]);
+    return args;
+}
+
+} // namespace
+
+int run_sweep(const Args& args, const Dataset& dataset, const std::vector<Vector>& queries) {
+    std::vector<Axis> build_axes, query_axes;
+    try {
+        for (Axis& axis : parse_spec(args))
+            (is_query_param(args, axis.name) ? query_axes : build_axes).push_back(std::move(axis));
+    } catch (const std::exception& e) {
+        std::cerr << "[Sweep] " << e.what() << "\n";
+        return 1;
+    }
+
+    // one truth at the largest N serves every N of the sweep; range truth
+    // depends on R, so a swept R gets one truth per radius
+    Params truth_params;
+    truth_params.N = args.N;
+    truth_params.enable_range = args.range;
+    std::vector<double> radii{args.R};
+    for (const Axis& axis : query_axes) {
+        if (axis.name == "N")
+            for (const std::string& v : axis.values) truth_params.N = std::max(truth_params.N, std::stoi(v));
+        if (axis.name == "R" && args.range) {
+            radii.clear();
+            for (const std::string& v : axis.values) radii.push_back(std::stod(v));
+        }
+    }
+    std::map<double, Truth> truths;
+    for (double R : radii) {
+        if (truths.count(R)) continue;
+        truth_params.R = R;
+        Truth& truth = truths[R];
+        truth.results = truth_cache::get_truth(args, dataset, queries, truth_params, truth.time_ms);
+    }
+
+    std::vector<std::string> columns;
+    for (const Axis& axis : build_axes) columns.push_back(axis.name);
+    for (const Axis& axis : query_axes) columns.push_back(axis.name);
+    std::ostringstream table;
+    for (const std::string& c : columns) table << c << "\t";
+    table << "Recall@N\tAF\tQPS\ttApproxAvg(ms)\tp99(ms)\tdist/q\tbuild(s)\n";
+    std::cout << "[Sweep] " << args.algo << ": " << combinations(build_axes).size() << " build x "
+              << combinations(query_axes).size() << " query points\n";
+
+    for (const auto& build_values : combinations(build_axes)) {
+        const Args build_args = with_values(args, build_axes, build_values);
+        auto approx = create_algorithm(build_args.algo);
+        auto tb0 = std::chrono::high_resolution_clock::now();
+        approx->configure(build_args);
+        approx->build_index(dataset);
+        auto tb1 = std::chrono::high_resolution_clock::now();
+        const double build_s = std::chrono::duration<double>(tb1 - tb0).count();
+
+        for (const auto& query_values : combinations(query_axes)) {
+            const Args run_args = with_values(build_args, query_axes, query_values);
+            approx->set_search_params(run_args);
+            Params params;
+            params.N = run_args.N;
+            params.R = run_args.R;
+            params.enable_range = run_args.range;
+
+            auto ta0 = std::chrono::high_resolution_clock::now();
+            auto approx_results = run_parallel_search(approx.get(), queries, args.threads, params, run_args.batch);
+            auto ta1 = std::chrono::high_resolution_clock::now();
+            const double approx_time_ms = std::chrono::duration<double, std::milli>(ta1 - ta0).count();
+            const Truth& truth = truths.at(args.range ? params.R : args.R);
+            const auto eval = evaluate_results(approx_results, truth.results, params.N, approx_time_ms, truth.time_ms);
+
+            std::ostringstream row;
+            for (const std::string& v : build_values) row << v << "\t";
+            for (const std::string& v : query_values) row << v << "\t";
+            row << std::fixed << std::setprecision(4) << eval.recall_at_N << "\t" << eval.average_AF << "\t"
+                << std::setprecision(1) << eval.qps << "\t" << std::setprecision(4) << eval.tApproxAvg << "\t";
+            if (eval.approx_latency.count > 0) row << eval.approx_latency.p99 << "\t";
+            else row << "n/a\t"; // batched: no per-query times
+            row << std::setprecision(1)
+                << double(eval.approx_work.distance_computations) / double(std::max<std::size_t>(1, eval.queries)) << "\t"
+                << std::setprecision(3) << build_s << "\n";
+            std::cout << "[Sweep] " << row.str();
+            table << row.str();
+        }
+    }
+
+    const std::filesystem::path out(args.output_path);
+    if (out.has_parent_path()) std::filesystem::create_directories(out.parent_path());
+    std::ofstream file(args.output_path);
+    if (!file) {
+        std::cerr << "[Sweep] Cannot write " << args.output_path << "\n";
+        return 1;
+    }
+    file << "Method: " << args.algo << "\n" << args.config_summary << "Sweep: " << args.sweep << "\n\n" << table.str();
+    std::cout << "[Sweep] table written to " << args.output_path << "\n";
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include <algorithm>
+
+#include "../../include/utils/thread_pool.h"
+#include "../../include/utils/numa.h"
+
+namespace {
+
+constexpr std::size_t kChunksPerSlot = 16; // default grain: each slot's range in about this many pops
+
+} // namespace
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+// called with mutex_ held and no job running
+void ThreadPool::grow(int participants) {
+    while (slots_.size() < static_cast<std::size_t>(participants)) slots_.push_back(std::make_unique<Slot>());
+    while (static_cast<int>(workers_.size()) + 1 < participants) {
+        const int slot = static_cast<int>(workers_.size()) + 1;
+        workers_.emplace_back([this, slot, seen = generation_] {
+            std::uint64_t generation = seen, placed = 0;
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lk(mutex_);
+                    wake_.wait(lk, [&] { return stop_ || generation_ != generation; });
+                    if (stop_) return;
+                    generation = generation_;
+                    if (slot >= participants_) continue;
+                    if (placed != placement_generation_) {
+                        apply_placement(slot);
+                        placed = placement_generation_;
+                    }
+                }
+                work(slot);
+                std::lock_guard<std::mutex> lk(mutex_);
+                if (--running_ == 0) done_.notify_one();
+            }
+        });
+    }
+}
+
+// called with mutex_ held (or before any worker exists)
+void ThreadPool::apply_placement(int slot) {
+    if (cpus_.empty()) return;
+    const std::size_t i = static_cast<std::size_t>(slot) % cpus_.size();
+    if (numa::pin_current_thread(cpus_[i])) numa::set_current_node(nodes_[i]);
+}
+
+void ThreadPool::set_placement(std::vector<int> cpus, std::vector<int> nodes) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    cpus_ = std::move(cpus);
+    nodes_ = std::move(nodes);
+    nodes_.resize(cpus_.size(), 0);
+    ++placement_generation_;
+    apply_placement(0);
+}
+
+void ThreadPool::run(std::size_t count, int threads, std::size_t grain, const RangeFn& fn) {
+    start(count, threads, grain, true, fn);
+}
+
+void ThreadPool::run_per_slot(int threads, const std::function<void(int)>& fn) {
+    const std::size_t count = static_cast<std::size_t>(std::max(1, threads));
+    start(count, threads, 1, false, [&fn](std::size_t lo, std::size_t hi, int) {
+        for (std::size_t s = lo; s < hi; ++s) fn(static_cast<int>(s)); // lo == slot unless run serially
+    });
+}
+
+void ThreadPool::start(std::size_t count, int threads, std::size_t grain, bool steal, const RangeFn& fn) {
+    if (count == 0) return;
+    const int participants = static_cast<int>(std::min<std::size_t>(std::max(1, threads), count));
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        if (participants == 1 || busy_) {
+            lk.unlock();
+            fn(0, count, 0);
+            return;
+        }
+        grow(participants);
+        busy_ = true;
+        for (int s = 0; s < participants; ++s) {
+            slots_[s]->lo = count * s / participants;
+            slots_[s]->hi = count * (s + 1) / participants;
+        }
+        participants_ = participants;
+        running_ = participants - 1;
+        grain_ = grain > 0 ? grain : std::max<std::size_t>(1, count / (participants * kChunksPerSlot));
+        steal_ = steal;
+        job_ = &fn;
+        error_ = nullptr;
+        failed_ = false;
+        ++generation_;
+    }
+    wake_.notify_all();
+    work(0);
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        done_.wait(lk, [&] { return running_ == 0; });
+        job_ = nullptr;
+        busy_ = false;
+        std::swap(error, error_);
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void ThreadPool::work(int slot) {
+    try {
+        std::size_t lo, hi;
+        while (!failed_.load(std::memory_order_relaxed)) {
+            if (pop_chunk(slot, lo, hi)) (*job_)(lo, hi, slot);
+            else if (!steal_ || !steal(slot)) return;
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (!error_) error_ = std::current_exception();
+        failed_ = true;
+    }
+}
+
+// next `grain_` indices from the front of the slot's own range
+bool ThreadPool::pop_chunk(int slot, std::size_t& lo, std::size_t& hi) {
+    Slot& s = *slots_[slot];
+    std::lock_guard<std::mutex> lk(s.m);
+    if (s.lo >= s.hi) return false;
+    lo = s.lo;
+    hi = std::min(s.hi, s.lo + grain_);
+    s.lo = hi;
+    return true;
+}
+
+// moves the back half of another slot's range (all of it if at most one
+// chunk is left) into this slot's empty range; false once every range is empty
+bool ThreadPool::steal(int slot) {
+    for (int off = 1; off < participants_; ++off) {
+        Slot& victim = *slots_[(slot + off) % participants_];
+        std::size_t lo, hi;
+        {
+            std::lock_guard<std::mutex> lk(victim.m);
+            if (victim.lo >= victim.hi) continue;
+            const std::size_t left = victim.hi - victim.lo;
+            lo = left <= grain_ ? victim.lo : victim.lo + left / 2;
+            hi = victim.hi;
+            victim.hi = lo;
+        }
+        Slot& own = *slots_[slot];
+        std::lock_guard<std::mutex> lk(own.m);
+        own.lo = lo;
+        own.hi = hi;
+        return true;
+    }
+    return false;
+}
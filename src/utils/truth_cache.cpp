@@ -0,0 +1,245 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#include "../../include/utils/truth_cache.h"
+#include "../../include/utils/mapped_file.h"
+#include "../../include/utils/fnv.h"
+#include "../../include/algorithms/brute_force_search.h"
+#include "../../include/common/metrics.h"
+#include "../../include/utils/thread_pool.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// queries re-run one by one after a tiled truth batch, for the latency percentiles
+constexpr std::size_t kTimedQueries = 1000;
+
+std::uint64_t hash_file(const std::string& path, std::uint64_t h) {
+    MappedFile file(path);
+    return fnv::hash_words(file.data(), file.size(), h);
+}
+
+std::string hex(std::uint64_t v) {
+    std::ostringstream s;
+    s << std::hex << std::setw(16) << std::setfill('0') << v;
+    return s.str();
+}
+
+std::string entry_prefix(const truth_cache::Key& key) {
+    return "gt_" + hex(key.data_hash) + "_" + hex(key.query_hash) + "_" + key.type + "_" + key.metric + "_";
+}
+
+std::string range_stem(const truth_cache::Key& key) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &key.R, sizeof bits);
+    return entry_prefix(key) + "r" + hex(bits);
+}
+
+// ivecs/fvecs: per record an int32 count followed by count values
+template <typename T>
+void write_vecs(const std::string& path, const std::vector<std::vector<T>>& records) {
+    // per-process name: concurrent runs storing the same entry must not share it
+    const std::string tmp = path + ".tmp." + std::to_string(::getpid());
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("Cannot write " + tmp);
+        for (const auto& rec : records) {
+            const std::int32_t n = static_cast<std::int32_t>(rec.size());
+            out.write(reinterpret_cast<const char*>(&n), sizeof n);
+            out.write(reinterpret_cast<const char*>(rec.data()), static_cast<std::streamsize>(rec.size() * sizeof(T)));
+        }
+        if (!out) throw std::runtime_error("Cannot write " + tmp);
+    }
+    fs::rename(tmp, path);
+}
+
+// reads every record, keeping at most `limit` values of each; false on a malformed file
+template <typename T>
+bool read_vecs(const std::string& path, std::size_t limit, std::vector<std::vector<T>>& records) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    records.clear();
+    std::int32_t n;
+    while (in.read(reinterpret_cast<char*>(&n), sizeof n)) {
+        if (n < 0) return false;
+        std::vector<T> rec(static_cast<std::size_t>(n));
+        if (!in.read(reinterpret_cast<char*>(rec.data()), static_cast<std::streamsize>(rec.size() * sizeof(T))))
+            return false;
+        if (rec.size() > limit) rec.resize(limit);
+        records.push_back(std::move(rec));
+    }
+    return in.eof();
+}
+
+} // namespace
+
+namespace truth_cache {
+
+std::uint64_t hash_path(const std::string& path) {
+    if (!fs::is_directory(path)) return hash_file(path, fnv::kOffset);
+    std::vector<std::string> parts;
+    for (const auto& entry : fs::directory_iterator(path))
+        if (entry.is_regular_file()) parts.push_back(entry.path().string());
+    std::sort(parts.begin(), parts.end());
+    std::uint64_t h = fnv::kOffset;
+    for (const std::string& part : parts) h = hash_file(part, h);
+    return h;
+}
+
+bool load(const std::string& dir, const Key& key, std::size_t n_queries, std::vector<SearchResult>& out) {
+    if (!fs::is_directory(dir)) return false;
+
+    // smallest cached N' >= N
+    const std::string prefix = entry_prefix(key) + "knn";
+    int best = std::numeric_limits<int>::max();
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        const std::string name = entry.path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) != 0) continue;
+        if (name.size() < 6 || name.compare(name.size() - 6, 6, ".ivecs") != 0) continue;
+        const std::string digits = name.substr(prefix.size(), name.size() - 6 - prefix.size());
+        if (digits.empty() || !std::all_of(digits.begin(), digits.end(), [](unsigned char c) { return std::isdigit(c); })) continue;
+        const int n = std::stoi(digits);
+        if (n >= key.N && n < best) best = n;
+    }
+    if (best == std::numeric_limits<int>::max()) return false;
+
+    const std::string stem = (fs::path(dir) / (prefix + std::to_string(best))).string();
+    const std::size_t N = static_cast<std::size_t>(key.N);
+    std::vector<std::vector<std::int32_t>> ids, range_ids;
+    std::vector<std::vector<float>> dists, times, range_dists;
+    if (!read_vecs(stem + ".ivecs", N, ids) || !read_vecs(stem + ".fvecs", N, dists) ||
+        !read_vecs(stem + ".time.fvecs", 2, times))
+        return false;
+    if (ids.size() != n_queries || dists.size() != n_queries || times.size() != n_queries) return false;
+
+    if (key.range) {
+        const std::string rstem = (fs::path(dir) / range_stem(key)).string();
+        const std::size_t all = std::numeric_limits<std::size_t>::max();
+        if (!read_vecs(rstem + ".ivecs", all, range_ids) || !read_vecs(rstem + ".fvecs", all, range_dists))
+            return false;
+        if (range_ids.size() != n_queries || range_dists.size() != n_queries) return false;
+    }
+
+    out.assign(n_queries, SearchResult());
+    for (std::size_t i = 0; i < n_queries; ++i) {
+        SearchResult& r = out[i];
+        r.query_id = static_cast<int>(i);
+        r.neighbor_ids.assign(ids[i].begin(), ids[i].end());
+        r.distances = std::move(dists[i]);
+        r.time_ms = times[i].empty() ? 0.0 : times[i][0];
+        r.shared_time = times[i].size() > 1 && times[i][1] != 0.0f;
+        if (key.range) {
+            r.range_neighbor_ids.assign(range_ids[i].begin(), range_ids[i].end());
+            r.range_distances = std::move(range_dists[i]);
+        }
+    }
+    std::cout << "[TruthCache] loaded " << n_queries << " queries from " << stem << ".ivecs"
+              << (best > key.N ? " (N=" + std::to_string(best) + ", truncated)" : "") << "\n";
+    return true;
+}
+
+void store(const std::string& dir, const Key& key, const std::vector<SearchResult>& results) {
+    fs::create_directories(dir);
+    std::vector<std::vector<std::int32_t>> ids, range_ids;
+    std::vector<std::vector<float>> dists, times, range_dists;
+    for (const SearchResult& r : results) {
+        ids.emplace_back(r.neighbor_ids.begin(), r.neighbor_ids.end());
+        dists.push_back(r.distances);
+        times.push_back({static_cast<float>(r.time_ms)});
+        if (r.shared_time) times.back().push_back(1.0f);
+        range_ids.emplace_back(r.range_neighbor_ids.begin(), r.range_neighbor_ids.end());
+        range_dists.push_back(r.range_distances);
+    }
+
+    const std::string stem = (fs::path(dir) / (entry_prefix(key) + "knn" + std::to_string(key.N))).string();
+    write_vecs(stem + ".fvecs", dists);
+    write_vecs(stem + ".time.fvecs", times);
+    if (key.range) {
+        const std::string rstem = (fs::path(dir) / range_stem(key)).string();
+        write_vecs(rstem + ".ivecs", range_ids);
+        write_vecs(rstem + ".fvecs", range_dists);
+    }
+    // the ids file is what load() looks for, so it goes last
+    write_vecs(stem + ".ivecs", ids);
+    std::cout << "[TruthCache] stored " << results.size() << " queries in " << stem << ".ivecs\n";
+}
+
+std::vector<SearchResult> get_truth(const Args& args, const Dataset& dataset, const std::vector<Vector>& queries,
+                                    const Params& params, double& truth_time_ms) {
+    std::vector<SearchResult> truth_results;
+    truth_time_ms = 0.0;
+    Key key;
+    bool keyed = false; // hash_path can throw: without a key the cache is skipped both ways
+    bool cached = false;
+    if (!args.truth_cache.empty()) {
+        try {
+            key.data_hash = hash_path(args.dataset_path);
+            key.query_hash = hash_path(args.query_path);
+            key.type = args.type;
+            key.metric = metrics::GLOBAL_METRIC_CFG.type == metrics::MetricType::L1 ? "l1" : "l2";
+            key.N = params.N;
+            key.R = params.R;
+            key.range = params.enable_range && params.R > 0.0;
+            keyed = true;
+            cached = load(args.truth_cache, key, queries.size(), truth_results);
+        } catch (const std::exception& e) {
+            std::cerr << "[TruthCache] unavailable: " << e.what() << "\n";
+        }
+    }
+
+    if (cached) {
+        // report the search time of the run that produced the cached truth
+        for (const auto& r : truth_results) truth_time_ms += r.time_ms;
+        truth_time_ms /= std::max(1, args.threads);
+        return truth_results;
+    }
+
+    auto truth = std::make_unique<BruteForceSearch>();
+    truth->configure(args);
+    truth->build_index(dataset);
+    std::cout << "[Main] dataset (" << dataset.bytes() / (1024 * 1024) << " MB) shared by "
+              << dataset.use_count() - 1 << " indexes\n";
+
+    std::cout << "[Main] Running truth (BruteForce) ...\n";
+    auto t0 = std::chrono::high_resolution_clock::now();
+    truth_results = truth->search_batch(queries.data(), queries.size(), params, args.threads);
+    auto t1 = std::chrono::high_resolution_clock::now();
+    truth_time_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    std::cout << "[Main] Truth (BruteForce) search completed in " << truth_time_ms / 1000 << " sec\n";
+
+    // tiled queries only have a share of their tile's time: re-run an evenly
+    // spaced sample with search(), which returns the same neighbours, so the
+    // truth percentiles come from per-query times
+    if (std::any_of(truth_results.begin(), truth_results.end(), [](const SearchResult& r) { return r.shared_time; })) {
+        const std::size_t nq = queries.size(), sample = std::min(nq, kTimedQueries);
+        parallel_for(sample, args.threads, [&](std::size_t s, int) {
+            const std::size_t i = nq * s / sample;
+            truth_results[i] = truth->search(queries[i], params, static_cast<int>(i));
+        });
+        std::cout << "[Main] Timed " << sample << " truth queries one by one\n";
+    }
+
+    if (keyed) {
+        try {
+            store(args.truth_cache, key, truth_results);
+        } catch (const std::exception& e) {
+            std::cerr << "[TruthCache] cannot store: " << e.what() << "\n";
+        }
+    }
+    return truth_results;
+}
+
+} // namespace truth_cache